@@ -0,0 +1,302 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "AudioDevice.h"
+
+#define WAV_HEADER 44
+#define FILE_BUFFER_PERIODS 4	// what a paced device holds, and how late capture can be before an overrun
+
+// file: and null devices, paced like a sound card unless AudioFast is set
+class CAudioDeviceFile : public CAudioDevice
+{
+public:
+	CAudioDeviceFile(bool is_capture, bool is_fast);
+	~CAudioDeviceFile();
+	bool Open(const std::string &path);	// empty for the null device
+
+	int Read(const AUDIO_SAMPLE *&audio);
+	int Delay(long &held);
+	AUDIO_SAMPLE *Buffer() { return samples; }
+	bool Paced() const { return ! fast; }
+	int Write(unsigned int count);
+
+private:
+	FILE *fp;
+	std::string name;
+	bool capture, fast;
+	uint32_t data_left;	// capture, WAV data bytes not read yet
+	uint32_t data_bytes;	// playback, WAV data bytes written
+	// the device clock: capture periods or playback frames since start
+	std::chrono::steady_clock::time_point start;
+	unsigned long long periods;
+	long long written;
+	short buffer[AUDIO_MAX_PLAY];
+	AUDIO_SAMPLE samples[AUDIO_MAX_PLAY];
+
+	bool read_header();
+	void write_header();
+	long long played() const;
+};
+
+static uint32_t get_le(const uint8_t *p, int n)
+{
+	uint32_t v = 0;
+	while (n--)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+static void put_le(uint8_t *p, uint32_t v, int n)
+{
+	for (int i=0; i<n; i++, v >>= 8)
+		p[i] = v & 0xffu;
+}
+
+static void swap_le(short *audio, unsigned int count)
+{
+#ifdef BIGENDIAN
+	for (unsigned int i=0; i<count; i++)
+		audio[i] = short((uint16_t(audio[i]) << 8) | (uint16_t(audio[i]) >> 8));
+#else
+	(void)audio;
+	(void)count;
+#endif
+}
+
+CAudioDeviceFile::CAudioDeviceFile(bool is_capture, bool is_fast) : fp(nullptr), capture(is_capture), fast(is_fast), data_left(0), data_bytes(0), periods(0), written(0)
+{
+	rate = 8000U;
+	start = std::chrono::steady_clock::now();
+}
+
+bool CAudioDeviceFile::Open(const std::string &path)
+{
+	name = path.empty() ? "null" : "'" + path + "'";
+	if (! path.empty()) {
+		fp = fopen(path.c_str(), capture ? "rb" : "wb");
+		if (nullptr == fp) {
+			std::cerr << "ERROR: can't open " << name << ": " << strerror(errno) << std::endl;
+			return true;
+		}
+		if (capture && read_header())
+			return true;
+		if (! capture)
+			write_header();
+	}
+	std::cout << "Audio " << (capture ? "capture from " : "playback to ") << name << (fast ? ", as fast as it goes" : "") << std::endl;
+	return false;
+}
+
+CAudioDeviceFile::~CAudioDeviceFile()
+{
+	if (nullptr == fp)
+		return;
+	if (! capture)
+		write_header();
+	fclose(fp);
+}
+
+// finds the samples of a mono 16 bit PCM WAV file at one of AUDIO_RATES
+bool CAudioDeviceFile::read_header()
+{
+	uint8_t hdr[12];
+	bool err = (12 != fread(hdr, 1, 12, fp) || memcmp(hdr, "RIFF", 4) || memcmp(hdr+8, "WAVE", 4));
+	bool fmt_ok = false;
+	while (! err) {
+		uint8_t chunk[8];
+		if (8 != fread(chunk, 1, 8, fp)) {
+			err = true;
+			break;
+		}
+		const uint32_t size = get_le(chunk+4, 4);
+		if (0 == memcmp(chunk, "fmt ", 4)) {
+			uint8_t fmt[16];
+			if (size < 16 || 16 != fread(fmt, 1, 16, fp) || fseek(fp, (size - 16) + (size & 1), SEEK_CUR)) {
+				err = true;
+				break;
+			}
+			rate = get_le(fmt+4, 4);
+			bool rate_ok = false;
+			for (unsigned int r : AUDIO_RATES)
+				rate_ok = rate_ok || r == rate;
+			fmt_ok = (1 == get_le(fmt, 2) && 1 == get_le(fmt+2, 2) && rate_ok && 16 == get_le(fmt+14, 2));
+			if (! fmt_ok) {
+				std::cerr << "ERROR: " << name << " is not mono 16 bit PCM at 8000, 16000, 44100 or 48000Hz" << std::endl;
+				return true;
+			}
+		} else if (0 == memcmp(chunk, "data", 4)) {
+			data_left = size;
+			break;
+		} else if (fseek(fp, size + (size & 1), SEEK_CUR)) {
+			err = true;
+		}
+	}
+	if (err || ! fmt_ok) {
+		std::cerr << "ERROR: " << name << " is not a usable WAV file" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+// an 8000Hz WAV header for what has been written so far
+void CAudioDeviceFile::write_header()
+{
+	uint8_t hdr[WAV_HEADER];
+	memcpy(hdr, "RIFF", 4);
+	put_le(hdr+4, 36 + data_bytes, 4);
+	memcpy(hdr+8, "WAVEfmt ", 8);
+	put_le(hdr+16, 16, 4);
+	put_le(hdr+20, 1, 2);		// PCM
+	put_le(hdr+22, 1, 2);		// mono
+	put_le(hdr+24, rate, 4);
+	put_le(hdr+28, 2 * rate, 4);	// byte rate
+	put_le(hdr+32, 2, 2);		// block align
+	put_le(hdr+34, 16, 2);
+	memcpy(hdr+36, "data", 4);
+	put_le(hdr+40, data_bytes, 4);
+	fseek(fp, 0, SEEK_SET);
+	fwrite(hdr, 1, WAV_HEADER, fp);
+	fseek(fp, 0, SEEK_END);
+}
+
+// Each period is ready 20 ms after the one before, like a sound card.
+// Falling more than FILE_BUFFER_PERIODS behind is an overrun.
+int CAudioDeviceFile::Read(const AUDIO_SAMPLE *&audio)
+{
+	const unsigned int frames = rate / 50;
+	audio = samples;
+	if (! fast) {
+		const auto due = start + std::chrono::milliseconds(20 * (periods + 1));
+		const auto now = std::chrono::steady_clock::now();
+		if (now > due + std::chrono::milliseconds(20 * FILE_BUFFER_PERIODS)) {
+			std::cerr << "overrun occurred" << std::endl;
+			start = now;
+			periods = 0;
+			memset(samples, 0, frames * sizeof(AUDIO_SAMPLE));
+			return -EPIPE;
+		}
+		std::this_thread::sleep_until(due);
+	}
+	periods++;
+	unsigned int n = 0;
+	if (fp) {
+		n = fread(buffer, sizeof(short), std::min(frames, unsigned(data_left / sizeof(short))), fp);
+		data_left -= n * sizeof(short);
+		if (0 == n) {
+			std::cout << "Audio capture reached the end of " << name << std::endl;
+			memset(samples, 0, frames * sizeof(AUDIO_SAMPLE));
+			return -ENODATA;
+		}
+		swap_le(buffer, n);
+	}
+	memset(buffer + n, 0, (frames - n) * sizeof(short));
+	to_sample(buffer, samples, frames);
+	return frames;
+}
+
+// the frames the device clock has played since start
+long long CAudioDeviceFile::played() const
+{
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return (long long)(ns * 1.0e-9 * rate);
+}
+
+int CAudioDeviceFile::Delay(long &held)
+{
+	held = 0;
+	if (fast || 0 == written)
+		return 0;
+	const long long done = played();
+	if (done > written) {
+		// ran dry, the clock starts again from what was written
+		start = std::chrono::steady_clock::now() - std::chrono::nanoseconds((long long)(written * 1.0e9 / rate));
+		return -EPIPE;
+	}
+	held = written - done;
+	return 0;
+}
+
+// Like a sound card, this blocks while the device holds more than
+// FILE_BUFFER_PERIODS.
+int CAudioDeviceFile::Write(unsigned int count)
+{
+	if (! fast) {
+		if (0 == written)
+			start = std::chrono::steady_clock::now();
+		const long long over = written + count - played() - FILE_BUFFER_PERIODS * rate / 50;
+		if (over > 0)
+			std::this_thread::sleep_for(std::chrono::nanoseconds((long long)(over * 1.0e9 / rate)));
+	}
+	written += count;
+	if (fp) {
+		from_sample(samples, buffer, count);
+		swap_le(buffer, count);
+		if (count != fwrite(buffer, sizeof(short), count, fp)) {
+			std::cerr << "ERROR: can't write " << name << ": " << strerror(errno) << std::endl;
+			return -EIO;
+		}
+		data_bytes += count * sizeof(short);
+	}
+	return count;
+}
+
+std::unique_ptr<CAudioDevice> CAudioDevice::Open(const std::string &name, bool capture, const CFGDATA &cfg)
+{
+	const bool is_file = (0 == name.compare(0, 5, "file:"));
+	if (is_file || 0 == name.compare("null")) {
+		auto device = std::make_unique<CAudioDeviceFile>(capture, cfg.bAudioFast);
+		if (device->Open(is_file ? name.substr(5) : ""))
+			return nullptr;
+		return device;
+	}
+	if (0 == name.compare(0, 4, "shm:"))
+		return open_shm(name.substr(4), capture);
+	return open_native(name, capture, cfg);
+}
+
+void CAudioDevice::to_sample(const short *in, AUDIO_SAMPLE *out, unsigned int count)
+{
+#ifdef FLOAT_AUDIO
+	for (unsigned int i=0; i<count; i++)
+		out[i] = in[i] / 32768.0f;
+#else
+	memcpy(out, in, count * sizeof(short));
+#endif
+}
+
+void CAudioDevice::from_sample(const AUDIO_SAMPLE *in, short *out, unsigned int count)
+{
+#ifdef FLOAT_AUDIO
+	for (unsigned int i=0; i<count; i++) {
+		const float s = in[i] * 32768.0f;
+		out[i] = (s >= 32767.0f) ? 32767 : ((s <= -32768.0f) ? -32768 : short(lrintf(s)));
+	}
+#else
+	memcpy(out, in, count * sizeof(short));
+#endif
+}
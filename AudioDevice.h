@@ -0,0 +1,75 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "TemplateClasses.h"
+#include "Configure.h"
+
+// device rates, in the order they are tried: 8000Hz needs no resampling,
+// the others are ordered by what the resampler costs
+#define AUDIO_RATES { 8000U, 16000U, 44100U, 48000U }
+#define AUDIO_MAX_PERIOD 960	// one 20 ms period at the highest rate
+#define AUDIO_MAX_PLAY (AUDIO_MAX_PERIOD + 16)	// a playback period, with room for drift correction
+
+// One open capture or playback stream, mono, one period is 20 ms at
+// Rate().  Open() picks the implementation from the device name:
+//   file:<path>  capture reads a mono 16 bit WAV file at one of
+//                AUDIO_RATES and ends the over at its end, playback
+//                writes each stream to an 8000Hz WAV file
+//   null         capture is silence, playback is thrown away
+//   shm:<name>   the shared memory rings of yamvoice_shm.h, at 8000Hz
+//   otherwise    the ALSA or sndio device the build was made for
+// The file and null devices keep real time, or with AudioFast=true in
+// the config run as fast as the pipeline takes the audio.
+class CAudioDevice
+{
+public:
+	virtual ~CAudioDevice() {}	// capture stops at once, playback plays out first
+
+	static std::unique_ptr<CAudioDevice> Open(const std::string &name, bool capture, const CFGDATA &cfg);
+	unsigned int Rate() const { return rate; }
+	virtual bool Paced() const { return true; }	// periods come and go in real time
+
+	// capture: points audio at the next period and returns its frames,
+	// -EPIPE after an overrun, or another negative error with audio
+	// silence.  Release() once audio has been used.
+	virtual int Read(const AUDIO_SAMPLE *&audio) = 0;
+	virtual void Release() {}
+	virtual bool Overruns() const { return true; }	// Read() can see them
+
+	// playback: Delay() gives the frames written and not played yet, and
+	// returns -EPIPE if the device ran dry since the last Write().  A
+	// period of up to Rate() / 50 + AUDIO_MAX_PLAY - AUDIO_MAX_PERIOD
+	// frames goes into Buffer(), Write() plays count of them and returns
+	// count, -EPIPE after an underrun or another negative error.
+	virtual int Delay(long &held) = 0;
+	virtual AUDIO_SAMPLE *Buffer() = 0;
+	virtual int Write(unsigned int count) = 0;
+
+protected:
+	unsigned int rate;
+
+	static std::unique_ptr<CAudioDevice> open_native(const std::string &name, bool capture, const CFGDATA &cfg);
+	static std::unique_ptr<CAudioDevice> open_shm(const std::string &name, bool capture);
+	static void to_sample(const short *in, AUDIO_SAMPLE *out, unsigned int count);
+	static void from_sample(const AUDIO_SAMPLE *in, short *out, unsigned int count);
+};
@@ -0,0 +1,320 @@
+/*
+ *   Copyright (c) 2019-2020 by Thomas A. Early N7TAE
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#define ALSA_PCM_NEW_HW_PARAMS_API
+#include <alsa/asoundlib.h>
+#include <netinet/in.h>
+
+#include <iostream>
+#include <cstring>
+
+#include "AudioDevice.h"
+#include "Trace.h"
+
+// with FLOAT_AUDIO the samples stay float from the device to the codec
+#ifdef FLOAT_AUDIO
+#define ALSA_FORMAT SND_PCM_FORMAT_FLOAT
+#else
+#define ALSA_FORMAT SND_PCM_FORMAT_S16_LE
+#endif
+
+// Pick the first of AUDIO_RATES the hardware runs at without ALSA's own
+// rate conversion, our resampler does the rest.  If none fits, let ALSA
+// convert to 8000Hz as before.
+static unsigned int set_audio_rate(snd_pcm_t *handle, snd_pcm_hw_params_t *params)
+{
+	snd_pcm_hw_params_set_rate_resample(handle, params, 0);
+	for (unsigned int rate : AUDIO_RATES)
+	{
+		if (0 == snd_pcm_hw_params_test_rate(handle, params, rate, 0))
+		{
+			snd_pcm_hw_params_set_rate(handle, params, rate, 0);
+			return rate;
+		}
+	}
+	std::cout << "Audio device has no native rate of 8000, 16000, 44100 or 48000Hz, using ALSA rate conversion" << std::endl;
+	snd_pcm_hw_params_set_rate_resample(handle, params, 1);
+	snd_pcm_hw_params_set_rate(handle, params, 8000, 0);
+	return 8000U;
+}
+
+// mmap access if the config asks for it and the device can do it,
+// read/write access otherwise.  Returns true for mmap.
+static bool set_access(snd_pcm_t *handle, snd_pcm_hw_params_t *params, bool want_mmap)
+{
+	if (want_mmap && 0 == snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_MMAP_INTERLEAVED))
+		return true;
+	if (want_mmap)
+		std::cout << "Audio device has no mmap access, using read/write" << std::endl;
+	snd_pcm_hw_params_set_access(handle, params, SND_PCM_ACCESS_RW_INTERLEAVED);
+	return false;
+}
+
+// where frame offset of the ring is, one channel
+static AUDIO_SAMPLE *mmap_area(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset)
+{
+	return (AUDIO_SAMPLE *)((char *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8);
+}
+
+// Waits until frames can be read or written without blocking, returns
+// a negative error code on xrun.
+static int mmap_wait(snd_pcm_t *handle, snd_pcm_uframes_t frames)
+{
+	for ( ; ; ) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(handle);
+		if (avail < 0)
+			return avail;
+		if (avail >= snd_pcm_sframes_t(frames))
+			return 0;
+		int rc = snd_pcm_wait(handle, 1000);
+		if (rc < 0)
+			return rc;
+	}
+}
+
+// Maps the next frames of the ring.  audio points into the ring, or at
+// bounce when the frames wrap around its end, in which case the first
+// part is copied and committed here.  offset and mapped are what the
+// caller commits once it is done with audio.
+static int mmap_read(snd_pcm_t *handle, snd_pcm_uframes_t frames, AUDIO_SAMPLE *bounce, const AUDIO_SAMPLE *&audio, snd_pcm_uframes_t &offset, snd_pcm_uframes_t &mapped)
+{
+	const snd_pcm_channel_area_t *areas;
+	int rc = mmap_wait(handle, frames);
+	mapped = frames;
+	if (rc < 0 || (rc = snd_pcm_mmap_begin(handle, &areas, &offset, &mapped)) < 0) {
+		mapped = 0;
+		return rc;
+	}
+	if (mapped == frames) {
+		audio = mmap_area(areas, offset);
+		return 0;
+	}
+	memcpy(bounce, mmap_area(areas, offset), mapped * sizeof(AUDIO_SAMPLE));
+	snd_pcm_mmap_commit(handle, offset, mapped);
+	snd_pcm_uframes_t done = mapped;
+	mapped = frames - done;
+	if ((rc = snd_pcm_mmap_begin(handle, &areas, &offset, &mapped)) < 0) {
+		mapped = 0;
+		return rc;
+	}
+	memcpy(bounce + done, mmap_area(areas, offset), mapped * sizeof(AUDIO_SAMPLE));
+	audio = bounce;
+	return 0;
+}
+
+// Copies count frames into the ring, for a period that did not fit
+// before its end.
+static void mmap_copy(snd_pcm_t *handle, const AUDIO_SAMPLE *audio, snd_pcm_uframes_t count)
+{
+	while (count > 0) {
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, mapped = count;
+		if (snd_pcm_mmap_begin(handle, &areas, &offset, &mapped) < 0 || 0 == mapped)
+			return;
+		memcpy(mmap_area(areas, offset), audio, mapped * sizeof(AUDIO_SAMPLE));
+		snd_pcm_mmap_commit(handle, offset, mapped);
+		audio += mapped;
+		count -= mapped;
+	}
+}
+
+class CAudioDeviceALSA : public CAudioDevice
+{
+public:
+	CAudioDeviceALSA(bool is_capture) : handle(nullptr), capture(is_capture), mapped(0) {}
+	~CAudioDeviceALSA();
+	bool Open(const std::string &name, bool want_mmap);
+
+	int Read(const AUDIO_SAMPLE *&audio);
+	void Release();
+	int Delay(long &held);
+	AUDIO_SAMPLE *Buffer();
+	int Write(unsigned int count);
+
+private:
+	snd_pcm_t *handle;
+	bool capture, use_mmap;
+	snd_pcm_uframes_t frames;	// one period
+	snd_pcm_uframes_t room;	// the longest period playout() can make
+	// the mmap ring area in use, direct when Buffer() is in the ring
+	snd_pcm_uframes_t offset, mapped;
+	bool direct;
+	int buffer_rc;
+	AUDIO_SAMPLE bounce[AUDIO_MAX_PLAY];	// read/write, or a period that wraps the mmap ring
+};
+
+bool CAudioDeviceALSA::Open(const std::string &name, bool want_mmap)
+{
+	int rc = snd_pcm_open(&handle, name.c_str(), capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK, 0);
+	if (rc < 0) {
+		std::cerr << "unable to open pcm device: " << snd_strerror(rc) << std::endl;
+		handle = nullptr;
+		return true;
+	}
+	// Allocate a hardware parameters object.
+	snd_pcm_hw_params_t *params;
+	snd_pcm_hw_params_alloca(&params);
+
+	// Fill it in with default values.
+	snd_pcm_hw_params_any(handle, params);
+
+	// Set the desired hardware parameters.
+
+	// Interleaved mode, mmap reads or writes the period where the device has it
+	use_mmap = set_access(handle, params, want_mmap);
+
+	// Signed 16-bit little-endian or native float format
+	snd_pcm_hw_params_set_format(handle, params, ALSA_FORMAT);
+
+	// One channels (mono)
+	snd_pcm_hw_params_set_channels(handle, params, 1);
+
+	// the device's own rate, one period is 20 ms
+	rate = set_audio_rate(handle, params);
+	frames = rate / 50;
+	snd_pcm_hw_params_set_period_size(handle, params, frames, 0);
+	if (use_mmap && ! capture) {
+		// playout() may make a little more than a period, that has to fit
+		unsigned int periods = 2;
+		snd_pcm_hw_params_set_periods_min(handle, params, &periods, 0);
+	}
+
+	// Write the parameters to the driver
+	rc = snd_pcm_hw_params(handle, params);
+	if (rc < 0) {
+		std::cerr << "unable to set hw parameters: " << snd_strerror(rc) << std::endl;
+		return true;
+	}
+	room = frames + AUDIO_MAX_PLAY - AUDIO_MAX_PERIOD;
+	if (use_mmap) {
+		std::cout << "Audio " << (capture ? "capture" : "playback") << " with mmap access" << std::endl;
+		if (capture)
+			snd_pcm_start(handle);
+	}
+	return false;
+}
+
+CAudioDeviceALSA::~CAudioDeviceALSA()
+{
+	if (nullptr == handle)
+		return;
+	if (capture)
+		snd_pcm_drop(handle);
+	else
+		snd_pcm_drain(handle);
+	snd_pcm_close(handle);
+}
+
+int CAudioDeviceALSA::Read(const AUDIO_SAMPLE *&audio)
+{
+	audio = bounce;
+	int rc;
+	if (use_mmap) {
+		TRACE_SPAN("snd_pcm_mmap read");
+		rc = mmap_read(handle, frames, bounce, audio, offset, mapped);
+	} else {
+		TRACE_SPAN("snd_pcm_readi");
+		rc = snd_pcm_readi(handle, bounce, frames);
+	}
+	if (rc == -EPIPE) {
+		// EPIPE means overrun
+		std::cerr << "overrun occurred" << std::endl;
+		snd_pcm_prepare(handle);
+		if (use_mmap)
+			snd_pcm_start(handle);
+	} else if (rc < 0) {
+		std::cerr << "error from readi: " << snd_strerror(rc) << std::endl;
+	} else if (! use_mmap && rc != int(frames)) {
+		std::cerr << "short readi, read " << rc << " frames" << std::endl;
+	}
+	if (rc < 0) {
+		audio = bounce;
+		memset(bounce, 0, frames * sizeof(AUDIO_SAMPLE));
+		return rc;
+	}
+	return use_mmap ? frames : rc;
+}
+
+void CAudioDeviceALSA::Release()
+{
+	if (mapped)
+		snd_pcm_mmap_commit(handle, offset, mapped);
+	mapped = 0;
+}
+
+int CAudioDeviceALSA::Delay(long &held)
+{
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay(handle, &delay) < 0)
+		delay = 0;
+	held = delay;
+	return 0;	// an underrun shows up in Write()
+}
+
+AUDIO_SAMPLE *CAudioDeviceALSA::Buffer()
+{
+	direct = false;
+	buffer_rc = 0;
+	if (use_mmap) {
+		const snd_pcm_channel_area_t *areas;
+		mapped = room;
+		TRACE_SPAN("snd_pcm_mmap wait");
+		buffer_rc = mmap_wait(handle, room);
+		if (buffer_rc >= 0)
+			buffer_rc = snd_pcm_mmap_begin(handle, &areas, &offset, &mapped);
+		if (buffer_rc >= 0 && mapped == room) {
+			direct = true;
+			return mmap_area(areas, offset);
+		}
+	}
+	return bounce;
+}
+
+int CAudioDeviceALSA::Write(unsigned int count)
+{
+	int rc = buffer_rc;
+	if (use_mmap) {
+		if (direct)
+			rc = snd_pcm_mmap_commit(handle, offset, count);
+		else if (rc >= 0)
+			mmap_copy(handle, bounce, count);
+		mapped = 0;
+		if (rc >= 0 && SND_PCM_STATE_PREPARED == snd_pcm_state(handle))
+			snd_pcm_start(handle);
+	} else {
+		TRACE_SPAN("snd_pcm_writei");
+		rc = snd_pcm_writei(handle, bounce, count);
+	}
+	if (rc == -EPIPE) {
+		// EPIPE means underrun
+		snd_pcm_prepare(handle);
+	} else if (rc < 0) {
+		std::cerr <<  "error from writei: " << snd_strerror(rc) << std::endl;
+	}  else if (! use_mmap && rc != int(count)) {
+		std::cerr << "short write, wrote " << rc << " frames" << std::endl;
+	}
+	return (rc < 0 || ! use_mmap) ? rc : count;
+}
+
+std::unique_ptr<CAudioDevice> CAudioDevice::open_native(const std::string &name, bool capture, const CFGDATA &cfg)
+{
+	auto device = std::make_unique<CAudioDeviceALSA>(capture);
+	if (device->Open(name, cfg.bAudioMmap))
+		return nullptr;
+	return device;
+}
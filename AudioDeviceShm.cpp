@@ -0,0 +1,166 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include "AudioDevice.h"
+#include "yamvoice_shm.h"
+
+#define SHM_TIMEOUT 100	// ms without the other program before it counts as away
+
+// shm:<name>, the rings of yamvoice_shm.h.  At 8000Hz and with 16 bit
+// samples capture hands out the period in the ring and playout() writes
+// straight into it, unless the period wraps around the ring's end.
+class CAudioDeviceShm : public CAudioDevice
+{
+public:
+	CAudioDeviceShm(bool is_capture) : shm(nullptr), capture(is_capture), direct(false), away(false), written(0) { rate = YV_SHM_RATE; }
+	~CAudioDeviceShm();
+	bool Open(const std::string &name);
+
+	int Read(const AUDIO_SAMPLE *&audio);
+	void Release();
+	int Delay(long &held);
+	AUDIO_SAMPLE *Buffer();
+	int Write(unsigned int count);
+
+private:
+	yv_shm *shm;
+	yv_ring *ring;
+	bool capture;
+	bool direct;	// the period is in the ring
+	bool away;	// playback, the other program isn't reading
+	unsigned long long written;
+	uint32_t xruns;	// the ring's overruns or underruns, last seen
+	int16_t bounce[AUDIO_MAX_PLAY];
+#ifdef FLOAT_AUDIO
+	float samples[AUDIO_MAX_PLAY];
+#endif
+};
+
+bool CAudioDeviceShm::Open(const std::string &name)
+{
+	shm = yv_shm_attach(name.c_str());
+	if (nullptr == shm) {
+		std::cerr << "ERROR: can't attach shared memory audio '" << name << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	ring = &shm->ring[capture ? YV_SHM_IN : YV_SHM_OUT];
+	if (capture)	// only what comes after PTT
+		yv_ring_consume(ring, yv_ring_readable(ring));
+	xruns = __atomic_load_n(capture ? &ring->overruns : &ring->underruns, __ATOMIC_RELAXED);
+	std::cout << "Audio " << (capture ? "capture from" : "playback to") << " shared memory /yamvoice-" << name << std::endl;
+	return false;
+}
+
+CAudioDeviceShm::~CAudioDeviceShm()
+{
+	if (nullptr == shm)
+		return;
+	if (! capture && ! away)	// let the other program read what is left
+		yv_ring_wait(ring, YV_SHM_SAMPLES, 0, yv_ring_readable(ring) / 8 + SHM_TIMEOUT);
+	yv_shm_detach(shm);
+}
+
+// A period, or silence when the other program has sent nothing for
+// SHM_TIMEOUT, so the over can still end.
+int CAudioDeviceShm::Read(const AUDIO_SAMPLE *&audio)
+{
+	direct = false;
+	int rc = 160;
+	const uint32_t overruns = __atomic_load_n(&ring->overruns, __ATOMIC_RELAXED);
+	if (overruns != xruns) {
+		xruns = overruns;
+		rc = -EPIPE;	// the other program lost samples, these are good
+	}
+	const int16_t *p = bounce;
+	if (! yv_ring_wait(ring, 160, 1, SHM_TIMEOUT))
+		memset(bounce, 0, sizeof(bounce));
+	else if (yv_ring_peek(ring, &p) >= 160)
+		direct = true;
+	else
+		yv_ring_read(ring, bounce, 160, 0);
+#ifdef FLOAT_AUDIO
+	to_sample(p, samples, 160);
+	audio = samples;
+	Release();
+#else
+	audio = p;
+#endif
+	return rc;
+}
+
+void CAudioDeviceShm::Release()
+{
+	if (direct)
+		yv_ring_consume(ring, 160);
+	direct = false;
+}
+
+int CAudioDeviceShm::Delay(long &held)
+{
+	held = yv_ring_readable(ring);
+	const uint32_t underruns = __atomic_load_n(&ring->underruns, __ATOMIC_RELAXED);
+	if (underruns == xruns)
+		return 0;
+	xruns = underruns;
+	return written ? -EPIPE : 0;	// it reads on its own clock, also before the stream
+}
+
+AUDIO_SAMPLE *CAudioDeviceShm::Buffer()
+{
+	const unsigned int room = 160 + AUDIO_MAX_PLAY - AUDIO_MAX_PERIOD;
+	direct = false;
+	away = ! yv_ring_wait(ring, room, 0, SHM_TIMEOUT);
+#ifdef FLOAT_AUDIO
+	return samples;
+#else
+	int16_t *p;
+	if (! away && yv_ring_reserve(ring, &p) >= room) {
+		direct = true;
+		return p;
+	}
+	return bounce;
+#endif
+}
+
+int CAudioDeviceShm::Write(unsigned int count)
+{
+	written += count;
+	if (away)	// the ring is full, nobody is listening
+		return count;
+#ifdef FLOAT_AUDIO
+	from_sample(samples, bounce, count);
+#endif
+	if (direct)
+		yv_ring_commit(ring, count);
+	else
+		yv_ring_write(ring, bounce, count, 0);
+	direct = false;
+	return count;
+}
+
+std::unique_ptr<CAudioDevice> CAudioDevice::open_shm(const std::string &name, bool capture)
+{
+	auto device = std::make_unique<CAudioDeviceShm>(capture);
+	if (device->Open(name))
+		return nullptr;
+	return device;
+}
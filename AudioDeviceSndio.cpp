@@ -0,0 +1,186 @@
+/*
+ *   Copyright (c) 2019-2020 by Thomas A. Early N7TAE
+ *   Copyright (c) 2024 by SASANO Takayoshi JG1UAA
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <sndio.h>
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include "AudioDevice.h"
+#include "Trace.h"
+
+#define byte2frame(x, y) ((x) / sizeof(y))
+#define frame2byte(x, y) ((x) * sizeof(y))
+
+// counts the frames played, for the playback delay
+static void onmove(void *arg, int delta)
+{
+	*(long *)arg += delta;
+}
+
+class CAudioDeviceSndio : public CAudioDevice
+{
+public:
+	CAudioDeviceSndio(bool is_capture) : handle(NULL), capture(is_capture), played(0), written(0) {}
+	~CAudioDeviceSndio();
+	bool Open(const std::string &device);
+
+	int Read(const AUDIO_SAMPLE *&audio);
+	bool Overruns() const { return false; }	// SIO_IGNORE drops them unseen
+	int Delay(long &held);
+	AUDIO_SAMPLE *Buffer();
+	int Write(unsigned int count);
+
+private:
+	struct sio_hdl *handle;
+	bool capture;
+	unsigned int frames;	// one period
+	long played, written;	// playback frames, for the delay
+	short buffer[AUDIO_MAX_PLAY];
+#ifdef FLOAT_AUDIO
+	float samples[AUDIO_MAX_PLAY];	// sndio only does integer samples, this is the one conversion
+#endif
+
+	bool setpar(int rate, int frames);
+};
+
+// Opens device at the first of AUDIO_RATES it accepts.  One period is
+// 20 ms at that rate.
+bool CAudioDeviceSndio::Open(const std::string &device)
+{
+	if ((handle = sio_open(device.c_str(), capture ? SIO_REC : SIO_PLAY, 0)) == NULL) {
+		std::cerr << "unable to open pcm device: " << device << std::endl;
+		return true;
+	}
+
+	bool found = false;
+	for (unsigned int try_rate : AUDIO_RATES) {
+		rate = try_rate;
+		if ((found = setpar(rate, rate / 50)))
+			break;
+	}
+	if (! found) {
+		std::cerr << "unable to set hw parameters: " << device << std::endl;
+		return true;
+	}
+	frames = rate / 50;
+	if (! capture)
+		sio_onmove(handle, onmove, &played);
+	return ! sio_start(handle);
+}
+
+bool CAudioDeviceSndio::setpar(int rate, int frames)
+{
+	struct sio_par q, r;
+	sio_initpar(&q);
+	q.bits = 16;
+	q.bps = SIO_BPS(q.bits);
+	q.sig = 1;
+	q.le = SIO_LE_NATIVE;
+	q.msb = 0;
+	q.rchan = q.pchan = 1;
+	q.rate = rate;
+	q.xrun = SIO_IGNORE;
+	q.appbufsz = frames * q.bps;
+
+	if (!sio_setpar(handle, &q) || !sio_getpar(handle, &r) ||
+	    q.bits != r.bits || q.bps != r.bps || q.sig != r.sig ||
+	    q.le != r.le || q.msb != r.msb ||
+	    (capture && q.rchan != r.rchan) ||
+	    (!capture && q.pchan != r.pchan) ||
+	    q.rate != r.rate || q.xrun != r.xrun || q.appbufsz != r.appbufsz)
+		return false;
+
+	return true;
+}
+
+CAudioDeviceSndio::~CAudioDeviceSndio()
+{
+	if (handle == NULL)
+		return;
+	sio_stop(handle);
+	sio_close(handle);
+}
+
+int CAudioDeviceSndio::Read(const AUDIO_SAMPLE *&audio)
+{
+	unsigned int n, pos, remain;
+	int rc = frames;
+	for (pos = 0; pos < frames; pos += byte2frame(n, short)) {
+		remain = frames - pos;
+		TRACE_SPAN("sio_read");
+		n = sio_read(handle, buffer + pos, frame2byte(remain, short));
+		if (0 == n && sio_eof(handle)) {
+			std::cerr << "error from sio_read" << std::endl;
+			memset(buffer, 0, frame2byte(frames, short));
+			rc = -EIO;
+			break;
+		}
+	}
+#ifdef FLOAT_AUDIO
+	to_sample(buffer, samples, frames);
+	audio = samples;
+#else
+	audio = buffer;
+#endif
+	return rc;
+}
+
+int CAudioDeviceSndio::Delay(long &held)
+{
+	if (written > 0 && played >= written) {
+		// the device ran dry, with SIO_IGNORE it paused or played silence
+		written = played;
+		held = 0;
+		return -EPIPE;
+	}
+	held = written - played;
+	return 0;
+}
+
+AUDIO_SAMPLE *CAudioDeviceSndio::Buffer()
+{
+#ifdef FLOAT_AUDIO
+	return samples;
+#else
+	return buffer;
+#endif
+}
+
+int CAudioDeviceSndio::Write(unsigned int count)
+{
+#ifdef FLOAT_AUDIO
+	from_sample(samples, buffer, count);
+#endif
+	{
+		TRACE_SPAN("sio_write");
+		sio_write(handle, buffer, frame2byte(count, short));
+	}
+	written += count;
+	return count;
+}
+
+std::unique_ptr<CAudioDevice> CAudioDevice::open_native(const std::string &name, bool capture, const CFGDATA &)
+{
+	auto device = std::make_unique<CAudioDeviceSndio>(capture);
+	if (device->Open(name))
+		return nullptr;
+	return device;
+}
@@ -19,61 +19,722 @@
 #include <iostream>
 #include <fstream>
 #include <thread>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <algorithm>
 
 #include "MainWindow.h"
 #include "AudioManager.h"
 #include "Configure.h"
 #include "codec2.h"
 #include "Callsign.h"
+#include "VoiceActivity.h"
+#include "RealTime.h"
+#include "Timer.h"
 
-CAudioManager::CAudioManager() : hot_mic(false), play_file(false), m17_sid_in(0U)
+CAudioManager::CAudioManager() : hot_mic(false), play_file(false), rx_session(false), rx_shown(false), rx_overloads(0), rx_dropped_ms(0), preroll_run(false)
 {
 	link_open = true;
 	volStats.count = 0;
 
-#ifdef USE44100
 	expand.data_in = expand_in;
 	expand.data_out = expand_out;
 	expand.input_frames = 160;
-	expand.output_frames = 882;
 	expand.end_of_input = false;
-	RSExpand.SetRatio(expand, 44100.0/8000.0);
 
 	shrink.data_in = shrink_in;
-	shrink.data_out = expand_out;
-	shrink.input_frames = 882;
+	shrink.data_out = shrink_out;
 	shrink.output_frames = 160;
 	shrink.end_of_input = false;
-	RSShrink.SetRatio(shrink, 8000.0/44100.0);
+	resample_ns[0] = resample_ns[1] = resample_periods[0] = resample_periods[1] = 0;
+	play_rate = 8000U;
+	play_periods = 0;
+	play_resampling = false;
+	play_paced = true;
+	play_slip = 0.0;
+	xrun_count[0] = xrun_count[1] = 0;
+	xrun_seconds[0] = xrun_seconds[1] = 0.0;
+	preroll_active = preroll_armed = false;
+	preroll_head = preroll_count = 0;
+}
+
+CAudioManager::~CAudioManager()
+{
+	for (std::size_t i=0; i<decoders.size(); i++)
+		rx_run.Push(nullptr);
+	for (auto &decoder : decoders)
+		decoder.get();
+}
+
+// Called by the audio backend once the device is open at rate.  Sets up
+// the resampler between rate and the codec's 8000Hz and logs the path,
+// returns true if resampling is needed.
+bool CAudioManager::set_device_rate(bool capture, unsigned int rate)
+{
+	const char *dir = capture ? "capture" : "playback";
+	resample_ns[capture ? 0 : 1] = resample_periods[capture ? 0 : 1] = 0;
+	if (! capture)
+	{
+		drift.Reset();
+		play_rate = rate;
+		play_periods = 0;
+		play_resampling = (8000U != rate);
+		play_slip = 0.0;
+	}
+	if (8000U == rate)
+	{
+		std::cout << "Audio " << dir << " at 8000Hz, no resampling" << std::endl;
+		return false;
+	}
+	if (capture)
+	{
+		shrink.input_frames = rate / 50;
+		RSShrink.SetRatio(shrink, 8000.0 / rate);
+	}
+	else
+	{
+		// take whatever the trimmed ratio gives, a period is not always rate / 50
+		expand.output_frames = AUDIO_MAX_PLAY;
+		RSExpand.SetRatio(expand, rate / 8000.0);
+	}
+	std::cout << "Audio " << dir << " at " << rate << "Hz, resampling with " << (capture ? RSShrink : RSExpand).Describe() << std::endl;
+	return true;
+}
+
+// One 20 ms period, between in and out at the device rate and 8000Hz.
+// On capture out is always 160 samples: the first period of a session
+// gives fewer, the filter delay, and they go at the end of the frame
+// after silence, so they run on into the next period's.
+bool CAudioManager::resample(bool capture, const short *in, short *out)
+{
+	auto start = std::chrono::steady_clock::now();
+	SDATA &data = capture ? shrink : expand;
+	CResampler &rs = capture ? RSShrink : RSExpand;
+	rs.Short2Float(in, data.data_in, data.input_frames);
+	bool rval = rs.Process(data);
+	const long pad = capture ? data.output_frames - data.output_frames_gen : 0;
+	if (pad > 0)
+		memset(out, 0, pad * sizeof(short));
+	rs.Float2Short(data.data_out, out + std::max(pad, 0L), data.output_frames_gen);
+	resample_ns[capture ? 0 : 1] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	resample_periods[capture ? 0 : 1]++;
+	return rval;
+}
+
+// float samples go straight through the resampler, no conversion
+bool CAudioManager::resample(bool capture, const float *in, float *out)
+{
+	auto start = std::chrono::steady_clock::now();
+	SDATA &data = capture ? shrink : expand;
+	CResampler &rs = capture ? RSShrink : RSExpand;
+	float *data_in = data.data_in, *data_out = data.data_out;
+	data.data_in = const_cast<float *>(in);
+	data.data_out = out;
+	bool rval = rs.Process(data);
+	data.data_in = data_in;
+	data.data_out = data_out;
+	const long pad = capture ? data.output_frames - data.output_frames_gen : 0;
+	if (pad > 0) {
+		memmove(out + pad, out, data.output_frames_gen * sizeof(float));
+		memset(out, 0, pad * sizeof(float));
+	}
+	resample_ns[capture ? 0 : 1] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	resample_periods[capture ? 0 : 1]++;
+	return rval;
+}
+
+void CAudioManager::log_resample_cost(bool capture)
+{
+	const int i = capture ? 0 : 1;
+	if (0 == resample_periods[i])
+		return;
+	const double us = resample_ns[i] / 1000.0 / resample_periods[i];
+	std::cout << "Audio " << (capture ? "capture" : "playback") << " resampling took " << us << " us per 20 ms period, " << us / 200.0 << "% of a CPU" << std::endl;
+}
+
+// Adds (drop false) or drops one sample of a 20 ms frame where the
+// waveform is smoothest, returns the new length.
+static unsigned int slip_sample(const AUDIO_SAMPLE *in, AUDIO_SAMPLE *out, bool drop)
+{
+	int best = 0;
+	for (int i=1; i<159; i++) {
+		if (fabs(double(in[i+1]) - in[i]) < fabs(double(in[best+1]) - in[best]))
+			best = i;
+	}
+	const AUDIO_SAMPLE mid = (in[best] + in[best+1]) / 2;
+	if (drop) {
+		memcpy(out, in, best * sizeof(AUDIO_SAMPLE));
+		out[best] = mid;
+		memcpy(out+best+1, in+best+2, (158-best) * sizeof(AUDIO_SAMPLE));
+		return 159;
+	}
+	memcpy(out, in, (best+1) * sizeof(AUDIO_SAMPLE));
+	out[best+1] = mid;
+	memcpy(out+best+2, in+best+1, (159-best) * sizeof(AUDIO_SAMPLE));
+	return 161;
+}
+
+// One 20 ms frame on its way to the device, latency seconds after it
+// with what is queued ahead of the device and what the device still
+// holds.  The latency is kept where it was when the stream settled: the
+// resampler ratio is trimmed, or at 8000Hz a sample is added or dropped
+// now and then.  count is the number of frames to write.
+bool CAudioManager::playout(const AUDIO_SAMPLE *in, AUDIO_SAMPLE *out, double latency, unsigned int &count)
+{
+	const double speedup = play_paced ? drift.Update(latency) : 0.0;
+	bool rval = false;
+	if (play_resampling) {
+		RSExpand.SetTrim(-speedup);
+		rval = resample(false, in, out);
+		count = expand.output_frames_gen;
+	} else {
+		play_slip += 160.0 * speedup;
+		if (play_slip >= 1.0) {
+			count = slip_sample(in, out, true);
+			play_slip -= 1.0;
+		} else if (play_slip <= -1.0) {
+			count = slip_sample(in, out, false);
+			play_slip += 1.0;
+		} else {
+			memcpy(out, in, 160 * sizeof(AUDIO_SAMPLE));
+			count = 160;
+		}
+	}
+	if (drift.Settled() && 0 == ++play_periods % 1500)	// every 30 s
+		log_drift();
+	return rval;
+}
+
+void CAudioManager::log_drift()
+{
+	if (! drift.Settled())
+		return;
+	std::cout << "Audio playback drift " << drift.Drift() * 1.0e6 << " ppm, latency " << drift.Latency() * 1000.0 << " ms, target " << drift.Target() * 1000.0 << " ms" << std::endl;
+}
+
+// With RealTime=true in the config, called first thing by each audio
+// thread.  Capture and playback wait on the device and get SCHED_FIFO,
+// the codec threads only run on their own CPU if one is configured.
+void CAudioManager::set_realtime(EAudioStage stage)
+{
+#ifdef USE_TRACE
+	static const char *names[] = { "capture", "encode", "decode", "playback" };
+	TRACE_THREAD(names[int(stage)]);
 #endif
+	auto cfgdata = pMainWindow->cfg.GetData();
+	if (! cfgdata->bRealTime)
+		return;
+	CRealTime::LockMemory();
+	int cpu = -1;
+	switch (stage) {
+		case EAudioStage::capture:
+			cpu = cfgdata->iCaptureCPU;
+			CRealTime::SetPriority(cfgdata->iRealTimePriority);
+			break;
+		case EAudioStage::encode:
+			cpu = cfgdata->iEncodeCPU;
+			break;
+		case EAudioStage::decode:
+			cpu = cfgdata->iDecodeCPU;
+			break;
+		case EAudioStage::playback:
+			cpu = cfgdata->iPlaybackCPU;
+			CRealTime::SetPriority(cfgdata->iRealTimePriority);
+			break;
+	}
+	if (cpu >= 0)
+		CRealTime::SetCPU(cpu);
+	CRealTime::PrefaultStack();
+}
+
+// for comparing settings, the rate is over every stream since start
+void CAudioManager::log_xruns(bool capture, unsigned long count, double seconds)
+{
+	const int i = capture ? 0 : 1;
+	xrun_count[i] += count;
+	xrun_seconds[i] += seconds;
+	std::cout << "Audio " << (capture ? "capture" : "playback") << ' ' << count << (capture ? " overruns" : " underruns") << " in " << seconds << " s, " << xrun_count[i] * 3600.0 / xrun_seconds[i] << " per hour since start" << std::endl;
+}
+
+// once an over or a receive session is done, if a queue ran full
+void CAudioManager::log_queue(const char *name, std::size_t overloads, std::size_t dropped_ms)
+{
+	if (0 == overloads && 0 == dropped_ms)
+		return;
+	std::cout << "Audio " << name << " queue full " << overloads << " times, " << dropped_ms << " ms of audio dropped to catch up" << std::endl;
+}
+
+// frames a queue holds for ms of audio, 0 is no limit
+static std::size_t queue_frames(int ms, unsigned int frame_ms = 20)
+{
+	return (ms > 0) ? std::max(1U, (ms + frame_ms - 1) / frame_ms) : 0;
+}
+
+// A backed up queue with the compress policy plays two frames in the
+// time of one, the first fading into the second, which keeps the ends
+// continuous with the frames before and after.
+static void crossfade(CAudioFrame &frame, const CAudioFrame &later)
+{
+	AUDIO_SAMPLE audio[160];
+	const AUDIO_SAMPLE *a = frame.GetData(), *b = later.GetData();
+	for (int i=0; i<160; i++)
+		audio[i] = AUDIO_SAMPLE((a[i] * (160 - i) + b[i] * i) / 160.0f);
+	CAudioFrame merged(audio);
+	merged.SetFlag(later.GetFlag());
+	merged.SetStamps(frame);
+	frame = merged;
+}
+
+// The capture thread, a 20 ms period at a time from the input device
+// to capture_frame() until it says stop.
+void CAudioManager::mic2audio()
+{
+	set_realtime(EAudioStage::capture);
+	auto data = pMainWindow->cfg.GetData();
+	auto device = CAudioDevice::Open(data->sAudioIn, true, *data);
+	if (! device)
+		return;
+	const bool resampling = set_device_rate(true, device->Rate());
+
+	unsigned long xruns = 0;
+	CTimer timer;
+	bool keep_running;
+	do {
+		AUDIO_SAMPLE audio_frame[160];
+		const AUDIO_SAMPLE *audio;
+		const int rc = device->Read(audio);
+		if (-EPIPE == rc)
+			xruns++;
+		bool fatal = rc < 0 && rc != -EPIPE;
+		if (resampling && resample(true, audio, audio_frame))
+			fatal = true;
+		keep_running = capture_frame(resampling ? audio_frame : audio, fatal);
+		device->Release();
+		// a device without a clock goes at the pace of the encoder
+		while (keep_running && ! device->Paced() && audio_queue.Size() > 4)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	} while (keep_running);
+	const bool overruns = device->Overruns();
+	device.reset();
+	log_resample_cost(true);
+	if (overruns)
+		log_xruns(true, xruns, timer.time());
+}
+
+// A stream that has been waiting this long joins the mix, the other
+// streams are kept within RX_MIX_BEHIND frames of the one playback paces on.
+#define RX_MIX_START 3
+#define RX_MIX_BEHIND 5
+
+static inline AUDIO_SAMPLE mix_clip(float s)
+{
+#ifdef FLOAT_AUDIO
+	return (s > 1.0f) ? 1.0f : ((s < -1.0f) ? -1.0f : s);
+#else
+	return (s >= 32767.0f) ? 32767 : ((s <= -32768.0f) ? -32768 : short(lrintf(s)));
+#endif
+}
+
+// Decodes for any stream on the run queue, until it pops a nullptr.  A
+// stream is scheduled by the first frame pushed after it was drained.
+void CAudioManager::decode_worker()
+{
+	set_realtime(EAudioStage::decode);
+	for (auto stream=rx_run.WaitPop(); stream; stream=rx_run.WaitPop()) {
+		do {
+			CC2DataFrame dataframe;
+			while (! (stream->hold && stream->pcm.Size() >= stream->hold) && stream->c2.TryPop(dataframe)) {
+				const bool last = dataframe.GetFlag();
+				stream->latency.Lap(ELatencyStage::decode_queue, dataframe);
+				TRACE_SPAN("codec2_decode");
+				if (stream->is_3200) {
+					AUDIO_SAMPLE audio[160];
+					stream->codec.codec2_decode(audio, dataframe.GetData());
+					CAudioFrame audioframe(audio);
+					audioframe.SetFlag(last);
+					audioframe.SetStamps(dataframe);
+					stream->latency.Lap(ELatencyStage::decode, audioframe);
+					stream->pcm.Push(audioframe);
+				} else {
+					AUDIO_SAMPLE audio[320];	// C2 1600 is 40 ms audio
+					stream->codec.codec2_decode(audio, dataframe.GetData());
+					CAudioFrame audio1(audio), audio2(audio+160);
+					audio2.SetFlag(last);
+					audio1.SetStamps(dataframe);
+					stream->latency.Lap(ELatencyStage::decode, audio1);
+					audio2.SetStamps(audio1);
+					stream->pcm.Push(audio1);
+					stream->pcm.Push(audio2);
+				}
+			}
+			stream->scheduled = false;
+			// a frame pushed, or room made by the mixer, before scheduled was cleared
+		} while (! stream->c2.IsEmpty() && ! (stream->hold && stream->pcm.Size() >= stream->hold) && ! stream->scheduled.exchange(true));
+	}
+}
+
+void CAudioManager::rx_push(const std::shared_ptr<SRxStream> &stream, const CC2DataFrame &frame)
+{
+	stream->c2.Push(frame);
+	if (! stream->scheduled.exchange(true))
+		rx_run.Push(stream);
+}
+
+// the mixer made room in a stream that decoding waits for
+void CAudioManager::rx_kick(const std::shared_ptr<SRxStream> &stream)
+{
+	if (stream->hold && ! stream->c2.IsEmpty() && ! stream->scheduled.exchange(true))
+		rx_run.Push(stream);
+}
+
+// Decoded audio is held to RxQueue by RxQueuePolicy.  With block the
+// codec frames are left undecoded until the mixer makes room, which
+// saves the CPU under load, and as the network can't be held up the
+// oldest codec frames are dropped past RxQueue.  Otherwise the codec
+// frames are only limited to four times that, for a starved decoder.
+// The echo holds the whole over as codec frames, its decoding waits.
+void CAudioManager::rx_limit(SRxStream &stream, bool network)
+{
+	auto data = pMainWindow->cfg.GetData();
+	if (data->iRxQueue <= 0)
+		return;
+	const std::size_t frames = std::max(std::size_t(RX_MIX_START + 1), queue_frames(data->iRxQueue));
+	const bool block = EQueuePolicy::block == data->eRxQueuePolicy;
+	if (network) {
+		stream.c2.SetLimit(queue_frames(data->iRxQueue * (block ? 1 : 4), stream.is_3200 ? 20 : 40), EQueuePolicy::drop_oldest);
+		if (! block) {
+			stream.pcm.SetLimit(frames, data->eRxQueuePolicy);
+			return;
+		}
+	}
+	stream.hold = frames;
+}
+
+// Adds stream to the mix, the first one starts the session and
+// rx_add() returns true.  Call it with rx_mutex held, it doesn't wait:
+// the new session waits for the last one to let go of the device.
+bool CAudioManager::rx_add(const std::shared_ptr<SRxStream> &stream)
+{
+	rx_streams.push_back(stream);
+	if (rx_session)
+		return false;
+	rx_session = true;
+	play_audio_fut = std::async(std::launch::async, &CAudioManager::play_audio, this, play_audio_fut).share();
+	return true;
+}
+
+// Tells the window if a receive is on, when that has changed.  Called by
+// the reader when a session starts and by the session when it is done,
+// whichever comes last reports the state as it is then.
+void CAudioManager::rx_notify()
+{
+	std::lock_guard<std::mutex> notify(rx_notify_mutex);
+	bool on;
+	{
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		on = rx_session;
+	}
+	if (on != rx_shown) {
+		rx_shown = on;
+		pMainWindow->Receive(on);
+	}
+}
+
+// One 20 ms period of the session's streams mixed into out.  Playback is
+// paced by the oldest stream, the mixer waits for its frames and queued
+// is how far ahead of the device they are in seconds.  A newer stream
+// joins once it has RX_MIX_START frames, and is left out of a period it
+// has nothing for.  One that comes in while the oldest is playing out
+// its last frames follows it instead, so streams back to back don't
+// overlap.  Each has a gain of 1/sqrt(streams), ramped over the
+// period when the number changes, so a stream played alone is untouched.
+// Returns true when the last stream has ended.
+bool CAudioManager::mix(AUDIO_SAMPLE *out, double &queued)
+{
+	bool tail;	// the oldest stream has closed, a new one waits for it
+	{
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		rx_mix.assign(rx_streams.begin(), rx_streams.end());
+		tail = rx_mix.front()->closed;
+	}
+	if (rx_primary && rx_primary != rx_mix.front())
+		drift.Rebase();	// the latency is now another stream's
+	rx_primary = rx_mix.front();
+
+	unsigned int playing = 0;
+	for (const auto &stream : rx_mix) {
+		if (stream->gain >= 0.0f || stream == rx_primary || (! tail && stream->pcm.Size() >= RX_MIX_START))
+			playing++;
+	}
+	const float target = 1.0f / sqrtf(float(playing));
+
+	float sum[160] = { 0.0f };
+	bool ended = false;
+	for (auto &stream : rx_mix) {
+		CAudioFrame frame;
+		if (stream == rx_primary) {
+			frame = stream->pcm.WaitPop();	// wait for a packet
+			CAudioFrame later;
+			if (! frame.GetFlag() && stream->pcm.PopOver(later)) {
+				crossfade(frame, later);
+				drift.Rebase();
+			}
+			queued = 0.02 * stream->pcm.Size();
+			rx_origin = frame.GetOrigin();
+		} else if (stream->gain < 0.0f && (tail || stream->pcm.Size() < RX_MIX_START)) {
+			continue;
+		} else {
+			bool have = stream->pcm.TryPop(frame);
+			while (have && ! frame.GetFlag() && stream->pcm.Size() > RX_MIX_BEHIND) {
+				have = stream->pcm.TryPop(frame);	// too far behind, drop one
+				rx_dropped_ms += 20;
+			}
+			if (! have)
+				continue;
+		}
+		rx_latency.Lap(ELatencyStage::playout_queue, frame);
+		rx_kick(stream);
+		if (stream->gain < 0.0f)
+			stream->gain = target;
+		const float step = (target - stream->gain) / 160.0f;
+		const AUDIO_SAMPLE *audio = frame.GetData();
+		for (unsigned int i=0; i<160; i++)
+			sum[i] += audio[i] * (stream->gain + step * (i + 1));
+		stream->gain = target;
+		if (frame.GetFlag()) {
+			ended = stream->ended = true;
+			stream->latency.AddTo(rx_latency);
+			rx_overloads += stream->c2.Overloads() + stream->pcm.Overloads();
+			rx_dropped_ms += stream->c2.Dropped() * (stream->is_3200 ? 20 : 40) + stream->pcm.Dropped() * 20;
+		}
+	}
+	for (unsigned int i=0; i<160; i++)
+		out[i] = mix_clip(sum[i]);
+	calc_audio_stats(out);
+
+	if (! ended)
+		return false;
+	std::lock_guard<std::mutex> lock(rx_mutex);
+	rx_streams.remove_if([](const std::shared_ptr<SRxStream> &stream) { return stream->ended; });
+	if (! rx_streams.empty())
+		return false;
+	rx_session = false;
+	return true;
+}
+
+// The playback thread for a receive session, from the mix of the streams
+// to the output device until the last stream ends, then it plays out
+// what the device holds and reports.  The streams queue up while it
+// waits for the previous session to be done with the device.
+void CAudioManager::play_audio(std::shared_future<void> previous)
+{
+	set_realtime(EAudioStage::playback);
+	auto data = pMainWindow->cfg.GetData();
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	if (previous.valid())
+		previous.wait();
+	rx_mix.reserve(std::max(1, data->iRxStreams) + 1);
+	rx_overloads = rx_dropped_ms = 0;
+	rx_latency.Reset();
+	calc_audio_stats();	// init volume stats
+	auto device = CAudioDevice::Open(data->sAudioOut, false, *data);
+	if (! device) {
+		std::cerr << "WARNING: received audio is thrown away" << std::endl;
+		device = CAudioDevice::Open("null", false, *data);
+	}
+	set_device_rate(false, device->Rate());
+	play_paced = device->Paced();
+
+	unsigned long xruns = 0;
+	CTimer timer;
+	bool last, failed;
+	do {
+		AUDIO_SAMPLE audio[160];
+		unsigned int count;
+		long delay;
+		double queued;
+		{
+			TRACE_SPAN("mix");
+			last = mix(audio, queued);
+		}
+		if (-EPIPE == device->Delay(delay)) {
+			xruns++;
+			drift.Rebase();
+		}
+		failed = playout(audio, device->Buffer(), queued + double(delay) / play_rate, count);
+		if (-EPIPE == device->Write(count)) {
+			xruns++;
+			drift.Rebase();
+		}
+		// the frame is heard once the device has played what it held
+		if (CAudioFrame::clock::time_point() != rx_origin) {
+			const double held = 1000.0 * delay / play_rate;
+			rx_latency.Add(ELatencyStage::device, held);
+			rx_latency.Add(ELatencyStage::network_to_speaker, std::chrono::duration<double, std::milli>(CAudioFrame::clock::now() - rx_origin).count() + held);
+		}
+	} while (! last && ! failed);
+	if (! last) {	// the resampler failed, end the session here
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		rx_streams.clear();
+		rx_session = false;
+	}
+	rx_mix.clear();
+	rx_primary.reset();
+	device.reset();	// plays out what the device still holds
+	log_resample_cost(false);
+	log_drift();
+	log_xruns(false, xruns, timer.time());
+	log_queue("receive", rx_overloads, rx_dropped_ms);
+	latency.StreamEnd(rx_latency, false);
+	rx_notify();
 }
 
 bool CAudioManager::Init(CMainWindow *pMain)
 {
 	pMainWindow = pMain;
 
+	// the decoders for every receive session, one per core up to RxStreams
+	const unsigned int cores = std::max(1U, std::thread::hardware_concurrency());
+	const unsigned int workers = std::min(cores, unsigned(std::max(1, pMainWindow->cfg.GetData()->iRxStreams)));
+	for (unsigned int i=0; i<workers; i++)
+		decoders.push_back(std::async(std::launch::async, &CAudioManager::decode_worker, this));
+
+	prompts.SetDir(std::string(CFGDIR) + "/prompts");
 	AM2M17.SetUp("am2m17");
 	LogInput.SetUp("log_input");
+	StartCapture();
 	return false;
 }
 
+// Starts the always on capture if the config wants a pre-roll and it
+// isn't running.  Not while the mic is keyed, KeyOff() tries again.
+void CAudioManager::StartCapture()
+{
+	const int preroll = pMainWindow->cfg.GetData()->iPreRoll;
+	if (preroll <= 0)
+		return;
+	std::lock_guard<std::mutex> capture(capture_mutex);
+	std::lock_guard<std::mutex> lock(preroll_mutex);
+	if (preroll_active || hot_mic)
+		return;
+	if (preroll_fut.valid())	// ended on its own, e.g. the device failed
+		preroll_fut.get();
+	unsigned int frames = (std::min(preroll, AUDIO_MAX_PREROLL) + 19) / 20;
+	preroll_ring.assign(frames, CAudioFrame());
+	preroll_head = preroll_count = 0;
+	preroll_active = preroll_run = true;
+	preroll_fut = std::async(std::launch::async, &CAudioManager::preroll_capture, this);
+	std::cout << "Audio capture always on, " << frames * 20 << " ms pre-roll" << std::endl;
+}
 
-void CAudioManager::RecordMicThread(E_PTT_Type for_who, const std::string &urcall)
+// an over in progress ends here
+void CAudioManager::StopCapture()
+{
+	std::lock_guard<std::mutex> capture(capture_mutex);
+	preroll_run = false;
+	if (preroll_fut.valid())
+		preroll_fut.get();
+}
+
+void CAudioManager::preroll_capture()
 {
-	// wait on audio queue to empty
+	mic2audio();
+	std::lock_guard<std::mutex> lock(preroll_mutex);
+	preroll_active = false;
+	if (preroll_armed) {
+		// the device went away in the middle of an over, or never opened
+		CAudioFrame quiet;
+		quiet.SetFlag(true);
+		audio_queue.Push(quiet);
+		preroll_armed = hot_mic = false;
+		preroll_done.set_value();
+	}
+}
+
+// The capture backends hand every 20 ms frame at 8000Hz to this, fatal
+// if the device or resampler failed.  Returns false when capture should
+// stop.  Opened for one over, the frame goes to the encoder.  Always on,
+// it goes into the pre-roll ring until PTT arms the capture, then the
+// ring and the frames after it go to the encoder until key off.
+bool CAudioManager::capture_frame(const AUDIO_SAMPLE *audio, bool fatal)
+{
+	CAudioFrame frame(audio);
+	frame.SetOrigin();
+	std::lock_guard<std::mutex> lock(preroll_mutex);
+	if (preroll_armed) {
+		for ( ; preroll_count > 0; preroll_count--) {
+			audio_queue.Push(preroll_ring[preroll_head]);
+			preroll_head = (preroll_head + 1) % preroll_ring.size();
+		}
+		const bool last = fatal || ! hot_mic || ! preroll_run;
+		frame.SetFlag(last);
+		audio_queue.Push(frame);
+		if (last) {
+			preroll_armed = hot_mic = false;
+			preroll_done.set_value();
+		}
+	} else if (preroll_active) {
+		preroll_ring[(preroll_head + preroll_count) % preroll_ring.size()] = frame;
+		if (preroll_count < preroll_ring.size())
+			preroll_count++;
+		else
+			preroll_head = (preroll_head + 1) % preroll_ring.size();
+	} else {
+		const bool keep_running = hot_mic && ! fatal;
+		if (! keep_running)
+			hot_mic = false;
+		frame.SetFlag(! keep_running);
+		audio_queue.Push(frame);
+		return keep_running;
+	}
+	return preroll_run && ! fatal;
+}
+
 
-	unsigned int count = 0u;
-	while (! audio_queue.IsEmpty()) {
-		std::this_thread::sleep_for(std::chrono::milliseconds(20));
-		count++;
+void CAudioManager::RecordMicThread(E_PTT_Type for_who, const std::string &urcall)
+{
+	// wait for the received audio to play out and the session to let go of
+	// the device, the last over's audio is gone since KeyOff() joined it
+	const auto wait_start = std::chrono::steady_clock::now();
+	bool waited = false;
+	for (;;) {
+		std::shared_future<void> session;
+		{
+			std::lock_guard<std::mutex> lock(rx_mutex);
+			session = play_audio_fut;
+		}
+		if (! session.valid() || std::future_status::ready == session.wait_for(std::chrono::seconds(0)))
+			break;
+		session.wait();
+		waited = true;
 	}
-	if (count > 0)
-		std::cout << "Tailgating detected! Waited " << count*20 << " ms for audio queue to clear." << std::endl;
+	if (waited)
+		std::cout << "Tailgating detected! Waited " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - wait_start).count() << " ms for the audio to clear." << std::endl;
 
 	auto data = pMainWindow->cfg.GetData();
-	hot_mic = true;
+	// the capture queue also takes the pre-roll at once, the encoder queue
+	// blocks so an overload comes back to the capture queue's policy, the
+	// echo keeps all of the over there
+	const std::size_t preroll_frames = (data->iPreRoll > 0) ? queue_frames(std::min(data->iPreRoll, AUDIO_MAX_PREROLL)) : 0;
+	audio_queue.SetLimit(queue_frames(data->iTxQueue) ? queue_frames(data->iTxQueue) + preroll_frames : 0, data->eTxQueuePolicy);
+	c2_queue.SetLimit((for_who == E_PTT_Type::m17) ? queue_frames(data->iTxQueue) : 0, EQueuePolicy::block);
+	ptt_time = std::chrono::steady_clock::now();
+	tx_latency.Reset();
+	bool preroll;
+	{
+		std::lock_guard<std::mutex> lock(preroll_mutex);
+		preroll = preroll_active;
+		if (preroll) {	// the mic is open, arm it
+			preroll_done = std::promise<void>();
+			mic2audio_fut = preroll_done.get_future();
+			preroll_armed = true;
+		}
+		hot_mic = true;
+	}
 
-	mic2audio_fut = std::async(std::launch::async, &CAudioManager::mic2audio, this);
+	if (! preroll)
+		mic2audio_fut = std::async(std::launch::async, &CAudioManager::mic2audio, this);
 
 	audio2codec_fut = std::async(std::launch::async, &CAudioManager::audio2codec, this, data->bVoiceOnlyEnable);
 
@@ -82,51 +743,159 @@ void CAudioManager::RecordMicThread(E_PTT_Type for_who, const std::string &urcal
 	}
 }
 
+// one analysed frame on its way to the quantiser thread
+using SC2Analysis = struct c2analysis_frame_tag {
+	C2ANALYSIS analysis;
+	bool last;
+	CC2DataFrame stamps;	// of the audio
+};
+
 void CAudioManager::audio2codec(const bool is_3200)
 {
+	set_realtime(EAudioStage::encode);
 	CCodec2 c2(is_3200);
+	auto cfgdata = pMainWindow->cfg.GetData();
+	CVoiceActivity vad;	// only used if silence detection is on
+	const bool detect = cfgdata->bSilenceDetect;
+	const bool pipeline = cfgdata->bEncoderPipeline;
+	switch (cfgdata->eEncoderEffort) {
+		case ECodecEffort::reduced:
+			c2.codec2_set_effort(CODEC2_EFFORT_REDUCED);
+			break;
+		case ECodecEffort::low:
+			c2.codec2_set_effort(CODEC2_EFFORT_LOW);
+			break;
+		default:
+			c2.codec2_set_effort(CODEC2_EFFORT_FULL);
+			break;
+	}
+
+	// With the encoder pipeline on, frames are analysed on this thread and
+	// quantised and packed on a second one, so the analysis of the next
+	// frame overlaps the quantisation of this one. That only shortens the
+	// path to the gateway when frames back up, e.g. after a stall, as each
+	// frame still needs its own analysis first. codec2_quantise() only
+	// reads the analysis, so both threads can share c2.
+	CTQueue<SC2Analysis> analysis_queue;
+	analysis_queue.SetLimit(4, EQueuePolicy::block);
+	std::future<void> quantise_fut;
+	if (pipeline) {
+		quantise_fut = std::async(std::launch::async, [&]() {
+			set_realtime(EAudioStage::encode);
+			bool done;
+			do {
+				SC2Analysis frame = analysis_queue.WaitPop();
+				unsigned char data[8];
+				{
+					TRACE_SPAN("codec2_quantise");
+					c2.codec2_quantise(data, &frame.analysis);
+				}
+				CC2DataFrame dataframe(data);
+				dataframe.SetFlag(frame.last);
+				dataframe.SetStamps(frame.stamps);
+				tx_latency.Lap(ELatencyStage::encode, dataframe);
+				c2_queue.Push(dataframe);
+				done = frame.last;
+			} while (! done);
+		});
+	}
+	auto send = [&](const AUDIO_SAMPLE *audio, bool voice, bool flag, const CAudioFrame &stamps) {
+		SC2Analysis frame;
+		{
+			TRACE_SPAN("codec2_analyse");
+			if (voice)
+				c2.codec2_analyse(&frame.analysis, audio);
+			else
+				c2.codec2_analyse_silence(&frame.analysis, audio);
+		}
+		if (pipeline) {
+			frame.last = flag;
+			frame.stamps.SetStamps(stamps);
+			analysis_queue.Push(frame);
+		} else {
+			unsigned char data[8];
+			{
+				TRACE_SPAN("codec2_quantise");
+				c2.codec2_quantise(data, &frame.analysis);
+			}
+			CC2DataFrame dataframe(data);
+			dataframe.SetFlag(flag);
+			dataframe.SetStamps(stamps);
+			tx_latency.Lap(ELatencyStage::encode, dataframe);
+			c2_queue.Push(dataframe);
+		}
+	};
+	// With silence detection a frame is held until the next one is in, and
+	// is only sent as silence if that one is silent too, so the start of a
+	// word that rises above the onset level a frame late isn't clipped.
+	AUDIO_SAMPLE held[320];
+	CAudioFrame held_stamps;
+	bool holding = false, held_voice = false;
+	auto encode = [&](const AUDIO_SAMPLE *audio, int count, bool flag, const CAudioFrame &stamps) {
+		if (! detect) {
+			send(audio, true, flag, stamps);
+			return;
+		}
+		const bool voice = vad.IsVoice(audio, count);
+		if (holding)
+			send(held, held_voice || voice, false, held_stamps);
+		holding = ! flag;
+		if (flag) {
+			send(audio, voice, true, stamps);
+		} else {
+			memcpy(held, audio, count * sizeof(AUDIO_SAMPLE));
+			held_stamps.SetStamps(stamps);
+			held_voice = voice;
+		}
+	};
+
+	// with the compress policy a backed up queue gives two frames in one
+	auto next_frame = [this]() {
+		CAudioFrame frame = audio_queue.WaitPop();
+		CAudioFrame later;
+		if (! frame.GetFlag() && audio_queue.PopOver(later))
+			crossfade(frame, later);
+		tx_latency.Lap(ELatencyStage::capture_queue, frame);
+		return frame;
+	};
+
 	bool last;
 	calc_audio_stats();  // initialize volume statistics
 	bool is_odd = false; // true if we've processed an odd number of audio frames
 	do {
 		// we'll wait until there is something
-		CAudioFrame audioframe = audio_queue.WaitPop();
+		CAudioFrame audioframe = next_frame();
 		calc_audio_stats(audioframe.GetData());
 		last = audioframe.GetFlag();
 		if ( is_3200 ) {
 			is_odd = ! is_odd;
-			unsigned char data[8];
-			c2.codec2_encode(data, audioframe.GetData());
-			CC2DataFrame dataframe(data);
-			dataframe.SetFlag(is_odd ? false : last);
-			c2_queue.Push(dataframe);
+			encode(audioframe.GetData(), 160, is_odd ? false : last, audioframe);
 			if (is_odd && last) { // we need an even number of data frame for 3200
 				// add one more quite frame
-				const short quiet[160] = { 0 };
-				c2.codec2_encode(data, quiet);
-				CC2DataFrame frame2(data);
-				frame2.SetFlag(true);
-				c2_queue.Push(frame2);
+				const AUDIO_SAMPLE quiet[160] = { 0 };
+				encode(quiet, 160, true, CAudioFrame());
 			}
 		} else { // 1600 - we need 40 ms of audio
-			short audio[320] = { 0 }; // initialize to 40 ms of silence
-			unsigned char data[8];
-			memcpy(audio, audioframe.GetData(), 160*sizeof(short)); // we'll put 20 ms of audio at the beginning
+			AUDIO_SAMPLE audio[320] = { 0 }; // initialize to 40 ms of silence
+			memcpy(audio, audioframe.GetData(), 160*sizeof(AUDIO_SAMPLE)); // we'll put 20 ms of audio at the beginning
+			CAudioFrame stamps;	// the older audio's
+			stamps.SetStamps(audioframe);
 			if (last) { // get another frame, if available
 				volStats.count += 160; // a quite frame will only contribute to the total count
 			} else {
 				//we'll wait until there is something
-				audioframe = audio_queue.WaitPop();
+				audioframe = next_frame();
 				calc_audio_stats(audioframe.GetData());
-				memcpy(audio+160, audioframe.GetData(), 160*sizeof(short));	// now we have 40 ms total
+				memcpy(audio+160, audioframe.GetData(), 160*sizeof(AUDIO_SAMPLE));	// now we have 40 ms total
 				last = audioframe.GetFlag();
 			}
-			c2.codec2_encode(data, audio);
-			CC2DataFrame dataframe(data);
-			dataframe.SetFlag(last);
-			c2_queue.Push(dataframe);
+			encode(audio, 320, last, stamps);
 		}
 	} while (! last);
+
+	if (pipeline)
+		quantise_fut.get();
+	log_queue("capture", audio_queue.Overloads(), audio_queue.Dropped() * 20);
 }
 
 void CAudioManager::QuickKey(const std::string &d, const std::string &s)
@@ -143,16 +912,20 @@ void CAudioManager::QuickKey(const std::string &d, const std::string &s)
 	const uint8_t quiet[] = { 0x01u, 0x00u, 0x09u, 0x43u, 0x9cu, 0xe4u, 0x21u, 0x08u };
 	memcpy(frame.payload,     quiet, 8);
 	memcpy(frame.payload + 8, quiet, 8);
+	CTxPacer pacer;
 	for (uint16_t i=0; i<5; i++) {
-		frame.SetFrameNumber((i < 4) ? i : i & 0x8000u);
+		frame.SetFrameNumber((i < 4) ? i : i | 0x8000u);
 		frame.SetCRC(crc.CalcCRC(frame));
+		pacer.Wait();
 		AM2M17.Write(frame.magic, sizeof(SM17Frame));
 	}
+	pacer.Log("quick key");
 	hot_mic = false;
 }
 
 void CAudioManager::codec2gateway(const std::string &dest, const std::string &sour, bool voiceonly)
 {
+	TRACE_THREAD("codec2gateway");
 	CCallsign destination(dest);
 	CCallsign source(sour);
 
@@ -165,6 +938,8 @@ void CAudioManager::codec2gateway(const std::string &dest, const std::string &so
 	destination.CodeOut(ipframe.lich.addr_dst);
 	source.CodeOut(ipframe.lich.addr_src);
 
+	// the encoder, or a file, may run ahead, the frames go out at 25 per second
+	CTxPacer pacer;
 	unsigned int count = 0;
 	bool last;
 	do {
@@ -172,6 +947,8 @@ void CAudioManager::codec2gateway(const std::string &dest, const std::string &so
 		CC2DataFrame cframe = c2_queue.WaitPop();
 		last = cframe.GetFlag();
 		memcpy(ipframe.payload, cframe.GetData(), 8);
+		tx_latency.Lap(ELatencyStage::send_queue, cframe);
+		CC2DataFrame stamps(cframe);	// the packet's are its older audio's
 		if (voiceonly) {
 			if (last) {
 				// we should never get here, but just in case...
@@ -183,6 +960,7 @@ void CAudioManager::codec2gateway(const std::string &dest, const std::string &so
 				cframe = c2_queue.WaitPop();
 				last = cframe.GetFlag();
 				memcpy(ipframe.payload+8, cframe.GetData(), 8);
+				tx_latency.Lap(ELatencyStage::send_queue, cframe);
 			}
 		}
 		// TODO: do something with the 2nd half of the payload when it's voice + "data"
@@ -194,97 +972,134 @@ void CAudioManager::codec2gateway(const std::string &dest, const std::string &so
 
 		// TODO: calculate crc
 
+		pacer.Wait();
+		tx_latency.Lap(ELatencyStage::pacing, stamps);
 		AM2M17.Write(ipframe.magic, sizeof(SM17Frame));
+		if (stamps.Stamped())
+			tx_latency.Add(ELatencyStage::mic_to_network, stamps.Age());
+		if (1 == count)
+			std::cout << "PTT to first M17 frame " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ptt_time).count() << " ms" << std::endl;
 	} while (! last);
+	pacer.Log("transmit");
+	log_queue("encoder", c2_queue.Overloads(), 0);
+	latency.StreamEnd(tx_latency, true);
 }
 
-void CAudioManager::codec2audio(const bool is_3200)
-{
-	CCodec2 c2(is_3200);
-	bool last;
-	calc_audio_stats(); // init volume stats
-	do {
-		// we'll wait until there is something
-		CC2DataFrame dataframe = c2_queue.WaitPop();
-		last = dataframe.GetFlag();
-		if (is_3200) {
-			short audio[160];
-			c2.codec2_decode(audio, dataframe.GetData());
-			CAudioFrame audioframe(audio);
-			audioframe.SetFlag(last);
-			audio_queue.Push(audioframe);
-			calc_audio_stats(audio);
-		} else {
-			short audio[320];	// C2 1600 is 40 ms audio
-			c2.codec2_decode(audio, dataframe.GetData());
-			CAudioFrame audio1(audio), audio2(audio+160);
-			audio1.SetFlag(false);
-			audio2.SetFlag(last);
-			audio_queue.Push(audio1);
-			audio_queue.Push(audio2);
-			calc_audio_stats(audio);
-			calc_audio_stats(audio+160);
-		}
-	} while (! last);
-}
-
+// the echo is played as a received stream
 void CAudioManager::PlayEchoDataThread()
 {
 	auto data = pMainWindow->cfg.GetData();
 	hot_mic = false;
 	mic2audio_fut.get();
 	audio2codec_fut.get();
+	latency.StreamEnd(tx_latency, true);
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(200));
 
-	codec2audio_fut = std::async(std::launch::async, &CAudioManager::codec2audio, this, data->bVoiceOnlyEnable);
-	play_audio_fut = std::async(std::launch::async, &CAudioManager::play_audio, this);
-	codec2audio_fut.get();
-	play_audio_fut.get();
+	auto stream = std::make_shared<SRxStream>(0U, data->bVoiceOnlyEnable, false);
+	rx_limit(*stream, false);
+	std::shared_future<void> session;
+	{
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		stream->closed = true;
+		rx_add(stream);
+		session = play_audio_fut;
+	}
+	CC2DataFrame dataframe;
+	while (c2_queue.TryPop(dataframe)) {
+		dataframe.SetStamps(CC2DataFrame());	// queued up, its latency says nothing
+		rx_push(stream, dataframe);
+	}
+	session.wait();
+}
+
+// A voice prompt is played as a received stream, straight from its
+// Codec2 frames.  It doesn't wait, decoding keeps pace with the mixer.
+void CAudioManager::PlayPrompt(const std::string &name)
+{
+	auto prompt = prompts.Get(name);
+	if (! prompt) {
+		std::cerr << "WARNING: there is no voice prompt '" << name << "'" << std::endl;
+		return;
+	}
+	auto stream = std::make_shared<SRxStream>(0U, prompt->Is3200(), false);
+	rx_limit(*stream, false);
+	bool started;
+	{
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		stream->closed = true;
+		started = rx_add(stream);
+	}
+	if (started)
+		rx_notify();
+	const std::size_t count = prompt->Frames();
+	for (std::size_t i=0; i<count; i++) {
+		CC2DataFrame dataframe(prompt->Frame(i));
+		dataframe.SetFlag(i + 1 == count);
+		rx_push(stream, dataframe);
+	}
+	std::cout << "Audio prompt " << name << " " << (prompt->Is3200() ? 0.02 : 0.04) * count << " s" << std::endl;
 }
 
+// Each stream is decoded on its own and mixed with the others, up to
+// RxStreams at once, a stream past that is dropped.
 void CAudioManager::M17_2AudioMgr(const SM17Frame &m17)
 {
-	static bool is_3200;
-	if (! play_file) {
-		if (0U==m17_sid_in && 0U==(m17.GetFrameNumber() & 0x8000u)) {	// don't start if it's the last audio frame
-			// here comes a new stream
-			m17_sid_in = m17.streamid;
-			is_3200 = ((m17.GetFrameType() & 0x6u) == 0x4u);
-			pMainWindow->Receive(true);
-			// launch the audio processing threads
-			codec2audio_fut = std::async(std::launch::async, &CAudioManager::codec2audio, this, is_3200);
-			play_audio_fut = std::async(std::launch::async, &CAudioManager::play_audio, this);
-		}
-		if (m17.streamid != m17_sid_in)
-			return;
-		auto payload = m17.payload;
-		CC2DataFrame dataframe(payload);
-		auto last = (0x8000u == (m17.GetFrameNumber() & 0x8000u));
-		dataframe.SetFlag(is_3200 ? false : last);
-		c2_queue.Push(dataframe);
-		if (is_3200) {
-			CC2DataFrame frame2(payload+8);
-			frame2.SetFlag(last);
-			c2_queue.Push(frame2);
+	if (play_file)
+		return;
+	const bool last = (0x8000u == (m17.GetFrameNumber() & 0x8000u));
+	std::shared_ptr<SRxStream> stream;
+	bool started = false;
+	{
+		std::lock_guard<std::mutex> lock(rx_mutex);
+		for (const auto &s : rx_streams) {
+			if (s->network && s->streamid == m17.streamid) {
+				if (s->closed)
+					return;
+				stream = s;
+				break;
+			}
 		}
-		if (last) {
-			codec2audio_fut.get();	// we're done, get the finished threads and reset the current stream id
-			play_audio_fut.get();
-			m17_sid_in = 0U;
-			pMainWindow->Receive(false);
+		if (! stream) {
+			// here comes a new stream, don't start it if it's the last audio frame
+			if (last || rx_streams.size() >= (size_t)std::max(1, pMainWindow->cfg.GetData()->iRxStreams))
+				return;
+			stream = std::make_shared<SRxStream>(m17.streamid, (m17.GetFrameType() & 0x6u) == 0x4u, true);
+			rx_limit(*stream, true);
+			started = rx_add(stream);
 		}
+		stream->closed = last;
+	}
+	if (started)
+		rx_notify();
+
+	const auto now = CC2DataFrame::clock::now();
+	auto payload = m17.payload;
+	CC2DataFrame dataframe(payload);
+	dataframe.SetFlag(stream->is_3200 ? false : last);
+	dataframe.SetOrigin(now);
+	rx_push(stream, dataframe);
+	if (stream->is_3200) {
+		CC2DataFrame frame2(payload+8);
+		frame2.SetFlag(last);
+		frame2.SetOrigin(now);
+		rx_push(stream, frame2);
 	}
+	// a last frame is left to the session, which plays it out and reports
 }
 
+// The over may have ended on its own, e.g. StopCapture() or the end of a
+// file input, its threads are joined all the same.
 void CAudioManager::KeyOff()
 {
-	if (hot_mic) {
-		hot_mic = false;
+	hot_mic = false;
+	if (mic2audio_fut.valid())
 		mic2audio_fut.get();
+	if (audio2codec_fut.valid())
 		audio2codec_fut.get();
+	if (codec2gateway_fut.valid())
 		codec2gateway_fut.get();
-	}
+	StartCapture();
 }
 
 void CAudioManager::Link(const std::string &linkcmd)
@@ -324,3 +1139,16 @@ void CAudioManager::calc_audio_stats(const short int *wave)
 		volStats.ss = 0.0;
 	}
 }
+
+// the stats stay in 16 bit units
+void CAudioManager::calc_audio_stats(const float *wave)
+{
+	double ss = 0.0;
+	for (unsigned int i=0; i<160; i++) {
+		double a = fabs(wave[i]) * 32768.0;
+		if (a > 16383.0) volStats.clip++;
+		if (i % 2) ss += a * a; // every other point will do
+	}
+	volStats.count += 160;
+	volStats.ss += ss;
+}
@@ -23,16 +23,24 @@
 #include <atomic>
 #include <mutex>
 #include <vector>
+#include <list>
+#include <memory>
 
 #include "TemplateClasses.h"
 #include "Packet.h"
 #include "Random.h"
 #include "UnixDgramSocket.h"
 #include "CRC.h"
+#include "codec2.h"
 
-#ifdef USE44100
 #include "Resampler.h"
-#endif
+#include "DriftEstimator.h"
+#include "AudioDevice.h"
+#include "VoicePrompt.h"
+#include "TxPacer.h"
+#include "Latency.h"
+
+#define AUDIO_MAX_PREROLL 2000	// ms
 
 using M17PacketQueue = CTQueue<SM17Frame>;
 using SVolStats = struct volstats_tag
@@ -41,7 +49,28 @@ using SVolStats = struct volstats_tag
 	double ss;
 };
 
+// One received stream, decoded on the worker pool and mixed for
+// playback.  scheduled is set while the stream is on the run queue or
+// being decoded, so only one worker has it at a time.
+using SRxStream = struct rxstream_tag
+{
+	rxstream_tag(unsigned short id, bool mode_3200, bool from_network) : streamid(id), network(from_network), is_3200(mode_3200), codec(mode_3200), scheduled(false), hold(0), closed(false), ended(false), gain(-1.0f) {}
+	const unsigned short streamid;
+	const bool network;	// only network streams are found by streamid, echo and prompts never are
+	const bool is_3200;
+	CCodec2 codec;
+	CC2DataQueue c2;	// to decode
+	CAudioQueue pcm;	// decoded, for the mixer
+	std::atomic<bool> scheduled;
+	unsigned int hold;	// decoding waits while pcm has this many, 0 never waits
+	bool closed;	// its last frame has come in
+	bool ended;	// and the mixer has played it
+	float gain;	// the mixer's, negative until it starts
+	CLatencySet latency;	// the decoder's stages, until the stream ends
+};
+
 enum class E_PTT_Type { echo, m17 };
+enum class EAudioStage { capture, encode, decode, playback };
 
 class CMainWindow;
 
@@ -49,14 +78,19 @@ class CAudioManager
 {
 public:
 	CAudioManager();
+	~CAudioManager();
 	bool Init(CMainWindow *);
 
 	void RecordMicThread(E_PTT_Type for_who, const std::string &urcall);
 	void PlayEchoDataThread();	// for Echo
 	void M17_2AudioMgr(const SM17Frame &m17);
+	void PlayPrompt(const std::string &name);
 	void KeyOff();
 	void QuickKey(const std::string &dest, const std::string &sour);
 	void Link(const std::string &linkcmd);
+	void StartCapture();	// the always on capture, if the config asks for a pre-roll
+	void StopCapture();
+	void LogLatency() const { latency.LogTotals(); }
 
 	// for volume stats
 	SVolStats volStats;
@@ -64,16 +98,56 @@ public:
 private:
 	// data
 	std::atomic<bool> hot_mic, play_file;
-	std::atomic<unsigned short> m17_sid_in;
 	CAudioQueue audio_queue;
 	CC2DataQueue c2_queue;
-	std::future<void> mic2audio_fut, audio2codec_fut, codec2gateway_fut, codec2audio_fut, play_audio_fut;
+	std::future<void> mic2audio_fut, audio2codec_fut, codec2gateway_fut;
+	// receive: the streams being played, oldest first, and the session
+	// that mixes and plays them, rx_mutex guards both.  A session starts
+	// while the last one may still be closing its device.
+	std::mutex rx_mutex;
+	std::list<std::shared_ptr<SRxStream>> rx_streams;
+	std::shared_future<void> play_audio_fut;
+	bool rx_session;
+	std::mutex rx_notify_mutex;	// orders the Receive() calls
+	bool rx_shown;	// the last Receive() call
+	CTQueue<std::shared_ptr<SRxStream>> rx_run;	// streams with frames to decode
+	std::vector<std::future<void>> decoders;
+	// the mixer's own: this period's streams, and the one it paces on
+	std::vector<std::shared_ptr<SRxStream>> rx_mix;
+	std::shared_ptr<SRxStream> rx_primary;
+	CAudioFrame::clock::time_point rx_origin;	// of the primary's frame, for the latency
+	std::size_t rx_overloads, rx_dropped_ms;	// this session's queue overloads
+	CLatencySet rx_latency;	// and its latency, with its streams' when they end
+	CPromptCache prompts;
+	CLatency latency;	// the totals
+	CLatencySet tx_latency;	// this transmission's
 	bool link_open;
-#ifdef USE44100
+	// resampling to and from the device rate, when it isn't 8000Hz
 	SDATA expand, shrink;
-	float expand_in[160], expand_out[882];
-	float shrink_in[882], shrink_out[160];
-#endif
+	float expand_in[160], expand_out[AUDIO_MAX_PLAY];
+	float shrink_in[AUDIO_MAX_PERIOD], shrink_out[160];
+	unsigned long long resample_ns[2], resample_periods[2];	// [0] capture, [1] playback
+	// playback clock drift
+	CDriftEstimator drift;
+	unsigned int play_rate, play_periods;
+	bool play_resampling;
+	bool play_paced;	// the device keeps real time, there is drift to correct
+	double play_slip;	// samples owed to the drift correction at 8000Hz
+	// pre-roll: with iPreRoll set the mic is always open and the last
+	// frames are kept in a ring, preroll_mutex guards the state below
+	std::mutex preroll_mutex;
+	std::atomic<bool> preroll_run;	// the always on capture should keep going
+	bool preroll_active;	// the always on capture thread is there
+	bool preroll_armed;	// PTT is down, frames go to audio_queue
+	std::mutex capture_mutex;	// orders StartCapture() and StopCapture(), before preroll_mutex
+	std::future<void> preroll_fut;	// capture_mutex guards it
+	std::promise<void> preroll_done;	// the armed over's last frame is queued
+	std::vector<CAudioFrame> preroll_ring;
+	unsigned int preroll_head, preroll_count;
+	std::chrono::steady_clock::time_point ptt_time;
+	// xruns since start, for the per hour rate
+	unsigned long xrun_count[2];	// [0] capture overruns, [1] playback underruns
+	double xrun_seconds[2];
 
 	// Unix sockets
 	CUnixDgramWriter AM2M17, LogInput;
@@ -82,16 +156,32 @@ private:
 	CRandom random;
 	std::vector<unsigned long> speak;
 	CCRC crc;
-#ifdef USE44100
 	// the Rational Resamplers
 	CResampler RSExpand, RSShrink;
-#endif
 
 	// methods
 	void mic2audio();
 	void audio2codec(const bool is_3200);
-	void codec2audio(const bool is_3200);
+	bool rx_add(const std::shared_ptr<SRxStream> &stream);
+	void rx_push(const std::shared_ptr<SRxStream> &stream, const CC2DataFrame &frame);
+	void rx_limit(SRxStream &stream, bool network);
+	void rx_kick(const std::shared_ptr<SRxStream> &stream);
+	void rx_notify();
+	void decode_worker();
+	bool mix(AUDIO_SAMPLE *out, double &queued);
 	void codec2gateway(const std::string &dest, const std::string &sour, bool voiceonly);
-	void play_audio();
+	void play_audio(std::shared_future<void> previous);
 	void calc_audio_stats(const short int *audio = nullptr);
+	void calc_audio_stats(const float *audio);
+	bool set_device_rate(bool capture, unsigned int rate);
+	bool resample(bool capture, const short *in, short *out);
+	bool resample(bool capture, const float *in, float *out);
+	void log_resample_cost(bool capture);
+	bool playout(const AUDIO_SAMPLE *in, AUDIO_SAMPLE *out, double latency, unsigned int &count);
+	void log_drift();
+	void set_realtime(EAudioStage stage);
+	void log_xruns(bool capture, unsigned long count, double seconds);
+	void log_queue(const char *name, std::size_t overloads, std::size_t dropped_ms);
+	bool capture_frame(const AUDIO_SAMPLE *audio, bool fatal);
+	void preroll_capture();
 };
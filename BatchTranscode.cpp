@@ -0,0 +1,607 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// yamvoice-batch: headless WAV <-> Codec2 <-> M17 transcoder
+//
+// Every input file becomes one or more tasks that a pool of worker
+// threads pulls from.  Encoding a long WAV file is split into segments
+// of whole M17 frames, each with its own CCodec2.  A segment starts
+// encoding a few frames early and throws that output away, so the
+// encoder's speech history and pitch tracker have settled by the time
+// its first kept frame comes around.  Segments read their samples
+// and write their frames at fixed offsets, so no file is ever held in
+// memory and the output does not depend on the order segments finish.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Callsign.h"
+#include "CRC.h"
+#include "Packet.h"
+#include "Random.h"
+#include "codec2.h"
+
+#define M17_SAMPLES   320	// one M17 stream frame is 40 ms of 8 kHz audio
+#define C2_BYTES      8		// one Codec2 3200 or 1600 frame
+#define WAV_HEADER    44
+
+enum class EFormat { none, wav, c2, m17 };
+
+struct SOptions
+{
+	EFormat     outfmt = EFormat::none;
+	std::string outdir;
+	bool        is_3200 = true;
+	int         effort = CODEC2_EFFORT_FULL;
+	std::string source, destination;
+	unsigned    jobs = 0;
+	double      segment_seconds = 60.0;
+	unsigned    warmup = 4;		// M17 frames encoded and discarded before each segment
+};
+
+struct SFile
+{
+	std::string      inname, outname;
+	EFormat          infmt, outfmt;
+	bool             is_3200;
+	uint16_t         streamid;
+	off_t            data_offset;	// WAV input, start of the samples
+	size_t           nsamples;		// WAV input
+	size_t           nm17;			// M17 frames in the output of an encode
+	std::atomic<int> tasks_left;
+	std::atomic<bool> failed;
+};
+
+struct STask
+{
+	SFile  *file;
+	size_t  first, last;	// M17 frames, encode tasks only
+};
+
+static SOptions opt;
+static CCRC crc;
+
+static EFormat FormatOf(const std::string &name)
+{
+	auto dot = name.rfind('.');
+	if (std::string::npos == dot)
+		return EFormat::none;
+	auto ext = name.substr(dot + 1);
+	if (0 == ext.compare("wav"))
+		return EFormat::wav;
+	if (0 == ext.compare("c2"))
+		return EFormat::c2;
+	if (0 == ext.compare("m17"))
+		return EFormat::m17;
+	return EFormat::none;
+}
+
+static const char *Extension(EFormat f)
+{
+	switch (f)
+	{
+		case EFormat::wav: return ".wav";
+		case EFormat::c2:  return ".c2";
+		case EFormat::m17: return ".m17";
+		default:           return "";
+	}
+}
+
+static uint32_t GetLE(const uint8_t *p, int n)
+{
+	uint32_t v = 0;
+	while (n--)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+static void PutLE(uint8_t *p, uint32_t v, int n)
+{
+	for (int i=0; i<n; i++, v>>=8)
+		p[i] = v & 0xffu;
+}
+
+static bool ReadAll(const std::string &name, std::vector<uint8_t> &data)
+{
+	auto fp = fopen(name.c_str(), "rb");
+	if (nullptr == fp)
+	{
+		std::cerr << "ERROR: can't open '" << name << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	uint8_t buf[4096];
+	size_t n;
+	while (0 < (n = fread(buf, 1, sizeof(buf), fp)))
+		data.insert(data.end(), buf, buf + n);
+	fclose(fp);
+	return false;
+}
+
+static bool WriteAll(const std::string &name, const std::vector<uint8_t> &data)
+{
+	auto fp = fopen(name.c_str(), "wb");
+	if (nullptr == fp)
+	{
+		std::cerr << "ERROR: can't create '" << name << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	bool err = (data.size() != fwrite(data.data(), 1, data.size(), fp));
+	if (fclose(fp) || err)
+	{
+		std::cerr << "ERROR: writing '" << name << "' failed" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+// find the samples of an 8 kHz, mono, 16 bit PCM WAV file
+static bool OpenWav(SFile &file)
+{
+	auto fp = fopen(file.inname.c_str(), "rb");
+	if (nullptr == fp)
+	{
+		std::cerr << "ERROR: can't open '" << file.inname << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	uint8_t hdr[12];
+	bool err = (12 != fread(hdr, 1, 12, fp) || memcmp(hdr, "RIFF", 4) || memcmp(hdr+8, "WAVE", 4));
+	bool fmt_ok = false;
+	while (! err)
+	{
+		uint8_t chunk[8];
+		if (8 != fread(chunk, 1, 8, fp))
+		{
+			err = true;
+			break;
+		}
+		uint32_t size = GetLE(chunk+4, 4);
+		if (0 == memcmp(chunk, "fmt ", 4))
+		{
+			uint8_t fmt[16];
+			if (size < 16 || 16 != fread(fmt, 1, 16, fp) || fseek(fp, (size - 16) + (size & 1), SEEK_CUR))
+			{
+				err = true;
+				break;
+			}
+			fmt_ok = (1 == GetLE(fmt, 2) && 1 == GetLE(fmt+2, 2) && 8000 == GetLE(fmt+4, 4) && 16 == GetLE(fmt+14, 2));
+			if (! fmt_ok)
+			{
+				std::cerr << "ERROR: '" << file.inname << "' is not 8000 Hz mono 16 bit PCM" << std::endl;
+				fclose(fp);
+				return true;
+			}
+		}
+		else if (0 == memcmp(chunk, "data", 4))
+		{
+			file.data_offset = ftell(fp);
+			struct stat st;
+			if (0 == fstat(fileno(fp), &st) && file.data_offset + off_t(size) > st.st_size)
+				size = st.st_size - file.data_offset;	// recording was cut short
+			file.nsamples = size / 2;
+			break;
+		}
+		else if (fseek(fp, size + (size & 1), SEEK_CUR))
+			err = true;
+	}
+	fclose(fp);
+	if (err || ! fmt_ok)
+	{
+		std::cerr << "ERROR: '" << file.inname << "' is not a usable WAV file" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+static void WavHeader(uint8_t *hdr, size_t nsamples)
+{
+	uint32_t bytes = nsamples * 2;
+	memcpy(hdr, "RIFF", 4);
+	PutLE(hdr+4, 36 + bytes, 4);
+	memcpy(hdr+8, "WAVEfmt ", 8);
+	PutLE(hdr+16, 16, 4);
+	PutLE(hdr+20, 1, 2);		// PCM
+	PutLE(hdr+22, 1, 2);		// mono
+	PutLE(hdr+24, 8000, 4);
+	PutLE(hdr+28, 16000, 4);	// byte rate
+	PutLE(hdr+32, 2, 2);		// block align
+	PutLE(hdr+34, 16, 2);
+	memcpy(hdr+36, "data", 4);
+	PutLE(hdr+40, bytes, 4);
+}
+
+static void MakeM17Frame(SM17Frame &frame, const SFile &file, size_t index, const uint8_t *c2data)
+{
+	memset(&frame, 0, sizeof(SM17Frame));
+	memcpy(frame.magic, "M17 ", 4);
+	frame.streamid = file.streamid;
+	frame.SetFrameType(file.is_3200 ? 0x5U : 0x7U);
+	CCallsign(opt.destination).CodeOut(frame.lich.addr_dst);
+	CCallsign(opt.source).CodeOut(frame.lich.addr_src);
+	memcpy(frame.payload, c2data, file.is_3200 ? 16 : 8);
+	uint16_t fn = index % 0x8000u;
+	if (index + 1 == file.nm17)
+		fn |= 0x8000u;
+	frame.SetFrameNumber(fn);
+	frame.SetCRC(crc.CalcCRC(frame));
+}
+
+// encode M17 frames [first, last) of a WAV file
+static bool EncodeSegment(const STask &task)
+{
+	SFile &file = *task.file;
+	CCodec2 c2(file.is_3200);
+	c2.codec2_set_effort(opt.effort);
+	const int spf = c2.codec2_samples_per_frame();
+	const int per_m17 = M17_SAMPLES / spf;
+
+	size_t warm = (task.first < opt.warmup) ? task.first : opt.warmup;
+	size_t start = (task.first - warm) * M17_SAMPLES;
+	size_t count = (task.last - task.first + warm) * M17_SAMPLES;
+
+	std::vector<short> audio(count, 0);
+	std::vector<uint8_t> raw(count * 2);
+	int fd = open(file.inname.c_str(), O_RDONLY);
+	if (0 > fd)
+	{
+		std::cerr << "ERROR: can't open '" << file.inname << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	size_t avail = (start < file.nsamples) ? file.nsamples - start : 0;
+	if (avail > count)
+		avail = count;
+	auto got = pread(fd, raw.data(), avail * 2, file.data_offset + start * 2);
+	close(fd);
+	if (got != ssize_t(avail * 2))
+	{
+		std::cerr << "ERROR: reading '" << file.inname << "' failed" << std::endl;
+		return true;
+	}
+	for (size_t i=0; i<avail; i++)
+		audio[i] = short(GetLE(&raw[2*i], 2));	// anything past the end stays silent
+
+	std::vector<uint8_t> bits((task.last - task.first) * per_m17 * C2_BYTES);
+	uint8_t discard[C2_BYTES];
+	size_t nframes = count / spf;
+	size_t nwarm = warm * per_m17;
+	for (size_t i=0; i<nframes; i++)
+		c2.codec2_encode((i < nwarm) ? discard : &bits[(i - nwarm) * C2_BYTES], &audio[i * spf]);
+
+	fd = open(file.outname.c_str(), O_WRONLY);
+	if (0 > fd)
+	{
+		std::cerr << "ERROR: can't open '" << file.outname << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	bool err;
+	if (EFormat::c2 == file.outfmt)
+	{
+		off_t offset = task.first * per_m17 * C2_BYTES;
+		err = (ssize_t(bits.size()) != pwrite(fd, bits.data(), bits.size(), offset));
+	}
+	else
+	{
+		std::vector<SM17Frame> frames(task.last - task.first);
+		for (size_t i=0; i<frames.size(); i++)
+			MakeM17Frame(frames[i], file, task.first + i, &bits[i * per_m17 * C2_BYTES]);
+		size_t size = frames.size() * sizeof(SM17Frame);
+		err = (ssize_t(size) != pwrite(fd, frames.data(), size, task.first * sizeof(SM17Frame)));
+	}
+	if (close(fd) || err)
+	{
+		std::cerr << "ERROR: writing '" << file.outname << "' failed" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+// pull the Codec2 frames out of a .c2 or .m17 file
+static bool ReadCodec2(SFile &file, std::vector<uint8_t> &bits)
+{
+	std::vector<uint8_t> data;
+	if (ReadAll(file.inname, data))
+		return true;
+
+	if (EFormat::c2 == file.infmt)
+	{
+		if (data.size() % C2_BYTES)
+			std::cerr << "WARNING: '" << file.inname << "' has a partial frame at the end, ignored" << std::endl;
+		data.resize(data.size() - data.size() % C2_BYTES);
+		bits.swap(data);
+		return false;
+	}
+
+	if (0 == data.size() || data.size() % sizeof(SM17Frame))
+	{
+		std::cerr << "ERROR: '" << file.inname << "' is not a stream of M17 frames" << std::endl;
+		return true;
+	}
+	size_t nframes = data.size() / sizeof(SM17Frame), bad_crc = 0;
+	for (size_t i=0; i<nframes; i++)
+	{
+		SM17Frame frame;
+		memcpy(&frame, &data[i * sizeof(SM17Frame)], sizeof(SM17Frame));
+		if (memcmp(frame.magic, "M17 ", 4))
+		{
+			std::cerr << "ERROR: '" << file.inname << "' frame " << i << " has no M17 magic" << std::endl;
+			return true;
+		}
+		if (0 == i)
+			file.is_3200 = ((frame.GetFrameType() & 0x6u) == 0x4u);
+		if (crc.CalcCRC(frame) != frame.GetCRC())
+			bad_crc++;
+		bits.insert(bits.end(), frame.payload, frame.payload + (file.is_3200 ? 16 : 8));
+		if (frame.GetFrameNumber() & 0x8000u)
+			break;
+	}
+	if (bad_crc)
+		std::cerr << "WARNING: '" << file.inname << "' " << bad_crc << " of " << nframes << " frames have a bad CRC" << std::endl;
+	return false;
+}
+
+// a whole .c2 or .m17 file, decoded to WAV or repacked
+static bool ConvertFile(SFile &file, size_t &nsamples)
+{
+	std::vector<uint8_t> bits;
+	if (ReadCodec2(file, bits))
+		return true;
+
+	const int spf = file.is_3200 ? 160 : 320;
+	size_t nframes = bits.size() / C2_BYTES;
+	nsamples = nframes * spf;
+	std::vector<uint8_t> out;
+
+	if (EFormat::wav == file.outfmt)
+	{
+		CCodec2 c2(file.is_3200);
+		out.resize(WAV_HEADER + nsamples * 2);
+		WavHeader(out.data(), nsamples);
+		short audio[320];
+		for (size_t i=0; i<nframes; i++)
+		{
+			c2.codec2_decode(audio, &bits[i * C2_BYTES]);
+			for (int j=0; j<spf; j++)
+				PutLE(&out[WAV_HEADER + 2 * (i * spf + j)], uint16_t(audio[j]), 2);
+		}
+	}
+	else if (EFormat::c2 == file.outfmt)
+	{
+		out.swap(bits);
+	}
+	else
+	{
+		const int per_m17 = M17_SAMPLES / spf;
+		if (nframes % per_m17)
+		{
+			CCodec2 c2(file.is_3200);
+			short silence[320] = { 0 };
+			uint8_t quiet[C2_BYTES];
+			c2.codec2_encode_silence(quiet, silence);
+			bits.insert(bits.end(), quiet, quiet + C2_BYTES);
+			nframes++;
+		}
+		file.nm17 = nframes / per_m17;
+		out.resize(file.nm17 * sizeof(SM17Frame));
+		for (size_t i=0; i<file.nm17; i++)
+		{
+			SM17Frame frame;
+			MakeM17Frame(frame, file, i, &bits[i * per_m17 * C2_BYTES]);
+			memcpy(&out[i * sizeof(SM17Frame)], &frame, sizeof(SM17Frame));
+		}
+	}
+	return WriteAll(file.outname, out);
+}
+
+static void Usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " -f wav|c2|m17 [options] file...\n"
+		"Converts between 8 kHz mono WAV, raw Codec2 (.c2) and M17 stream frames (.m17).\n"
+		"The input format comes from each file's extension.\n"
+		"  -f FORMAT   output format\n"
+		"  -o DIR      output directory, default is next to each input\n"
+		"  -m MODE     Codec2 mode for WAV and .c2 input, 3200 (default) or 1600\n"
+		"  -e EFFORT   encoder effort, full (default), reduced or low\n"
+		"  -S CS       M17 source callsign, needed for .m17 output\n"
+		"  -D CS       M17 destination callsign, needed for .m17 output\n"
+		"  -j N        worker threads, default is one per core\n"
+		"  -s SECONDS  encode WAV files in segments this long, 0 for whole files, default 60\n"
+		"  -w FRAMES   40 ms frames encoded ahead of each segment to settle the encoder, default 4\n";
+}
+
+int main(int argc, char *argv[])
+{
+	int c;
+	while (-1 != (c = getopt(argc, argv, "f:o:m:e:S:D:j:s:w:h")))
+	{
+		switch (c)
+		{
+			case 'f':
+				opt.outfmt = FormatOf(std::string(".") + optarg);
+				break;
+			case 'o':
+				opt.outdir.assign(optarg);
+				break;
+			case 'm':
+				opt.is_3200 = (0 != strcmp(optarg, "1600"));
+				break;
+			case 'e':
+				if (0 == strcmp(optarg, "low"))
+					opt.effort = CODEC2_EFFORT_LOW;
+				else if (0 == strcmp(optarg, "reduced"))
+					opt.effort = CODEC2_EFFORT_REDUCED;
+				else
+					opt.effort = CODEC2_EFFORT_FULL;
+				break;
+			case 'S':
+				opt.source.assign(optarg);
+				break;
+			case 'D':
+				opt.destination.assign(optarg);
+				break;
+			case 'j':
+				opt.jobs = atoi(optarg);
+				break;
+			case 's':
+				opt.segment_seconds = atof(optarg);
+				break;
+			case 'w':
+				opt.warmup = atoi(optarg);
+				break;
+			default:
+				Usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (EFormat::none == opt.outfmt || optind >= argc)
+	{
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (EFormat::m17 == opt.outfmt && (opt.source.empty() || opt.destination.empty()))
+	{
+		std::cerr << "ERROR: M17 output needs -S and -D callsigns" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (0 == opt.jobs)
+		opt.jobs = std::thread::hardware_concurrency();
+	if (0 == opt.jobs)
+		opt.jobs = 1;
+
+	const size_t seg_m17 = (0.0 < opt.segment_seconds) ? size_t(opt.segment_seconds * 8000.0 / M17_SAMPLES + 0.5) : 0;
+	std::vector<std::unique_ptr<SFile>> files;
+	std::vector<STask> tasks;
+	CRandom random;
+	int errors = 0;
+
+	for (int i=optind; i<argc; i++)
+	{
+		auto file = std::make_unique<SFile>();
+		file->inname.assign(argv[i]);
+		file->infmt = FormatOf(file->inname);
+		file->outfmt = opt.outfmt;
+		file->is_3200 = opt.is_3200;
+		file->streamid = random.NewStreamID();
+		file->nsamples = file->nm17 = 0;
+		file->failed = false;
+		if (EFormat::none == file->infmt || file->infmt == file->outfmt)
+		{
+			std::cerr << "ERROR: don't know how to convert '" << file->inname << "' to " << Extension(opt.outfmt) << std::endl;
+			errors++;
+			continue;
+		}
+
+		auto base = file->inname.substr(0, file->inname.rfind('.'));
+		if (! opt.outdir.empty())
+		{
+			auto slash = base.rfind('/');
+			base = opt.outdir + "/" + ((std::string::npos == slash) ? base : base.substr(slash + 1));
+		}
+		file->outname = base + Extension(opt.outfmt);
+
+		if (EFormat::wav == file->infmt)
+		{
+			if (OpenWav(*file))
+			{
+				errors++;
+				continue;
+			}
+			// whole M17 frames, the last one padded with silence
+			file->nm17 = (file->nsamples + M17_SAMPLES - 1) / M17_SAMPLES;
+			const int per_m17 = file->is_3200 ? 2 : 1;
+			off_t size = (EFormat::c2 == file->outfmt) ? file->nm17 * per_m17 * C2_BYTES : file->nm17 * sizeof(SM17Frame);
+			int fd = open(file->outname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (0 > fd || ftruncate(fd, size))
+			{
+				std::cerr << "ERROR: can't create '" << file->outname << "': " << strerror(errno) << std::endl;
+				if (0 <= fd)
+					close(fd);
+				errors++;
+				continue;
+			}
+			close(fd);
+			const size_t step = seg_m17 ? seg_m17 : file->nm17;
+			int n = 0;
+			for (size_t first=0; first<file->nm17; first+=step, n++)
+				tasks.push_back({ file.get(), first, (first + step < file->nm17) ? first + step : file->nm17 });
+			file->tasks_left = n;
+		}
+		else
+		{
+			tasks.push_back({ file.get(), 0, 0 });
+			file->tasks_left = 1;
+		}
+		files.push_back(std::move(file));
+	}
+
+	std::atomic<size_t> next_task(0), total_samples(0);
+	std::atomic<int> failures(0);
+	auto worker = [&]()
+	{
+		size_t t;
+		while ((t = next_task++) < tasks.size())
+		{
+			auto &task = tasks[t];
+			SFile &file = *task.file;
+			bool err;
+			size_t nsamples = 0;
+			if (EFormat::wav == file.infmt)
+			{
+				err = EncodeSegment(task);
+				nsamples = (task.last - task.first) * M17_SAMPLES;
+			}
+			else
+				err = ConvertFile(file, nsamples);
+			if (err)
+				file.failed = true;
+			total_samples += nsamples;
+			if (0 == --file.tasks_left)
+			{
+				if (file.failed)
+					failures++;
+				else
+					std::cout << file.inname << " -> " << file.outname << std::endl;
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (unsigned i=0; i<opt.jobs; i++)
+		pool.emplace_back(worker);
+	for (auto &th : pool)
+		th.join();
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double audio = total_samples / 8000.0;
+	fprintf(stderr, "%zu file(s), %.1f s of audio in %.2f s with %u thread(s), %.0fx realtime\n",
+		files.size(), audio, wall, opt.jobs, (0.0 < wall) ? audio / wall : 0.0);
+
+	return (errors || failures) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
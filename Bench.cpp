@@ -0,0 +1,985 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// yamvoice-bench: Codec2 encode and decode timing
+//
+// Runs the 3200 and 1600 encoders and decoders over a speech corpus and
+// writes frames/sec, ns/frame and a per stage breakdown as JSON.  The
+// whole frame times come from runs with profiling off, the best of -n
+// runs for each frame, which keeps scheduler noise out of the numbers.
+// A separate profiled run gives the share of each stage; stage times
+// are scaled to ns per codec frame and "other" is whatever the listed
+// stages do not cover.  With -b the results are compared against a
+// baseline written by an earlier run.
+//
+// The corpus is built in: deterministic synthetic talkers (glottal
+// pulse train through three formant resonators, with unvoiced frication
+// and pauses), so results are repeatable on any host without shipping
+// recordings.  8 kHz mono 16 bit WAV files given on the command line
+// are used instead when present.
+//
+// -R and -C record and check a golden vector set: the input PCM, the
+// frames of both encoders and the decoder output for those frames.  A
+// check re-encodes the recorded input and must match the frames bit for
+// bit, then decodes the recorded frames and compares the output.  The
+// float decoder must match it exactly, the fixed point decoder has an
+// SNR and maximum sample error budget.  A check also saves and restores
+// the codec state partway and the result must carry on bit exact, and it
+// measures the alias and image rejection of the audio resampler.
+//
+// The streams_ results are the receive side with several streams at
+// once: a frame is one codec frame from each stream, every stream with
+// its own decoder and its own place in the corpus, mixed as the
+// playback mixer does.  streams_per_core is how many streams one core
+// keeps up with in real time.
+//
+// The trace_span_ results time one TRACE_SPAN, with tracing switched
+// off and on at run time; the one that is on has to stay within the
+// -T budget.  A build without the TRACE option has no spans at all.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <getopt.h>
+
+#include "codec2.h"
+#include "Resampler.h"
+#include "Trace.h"
+
+#define BENCH_VERSION 1
+
+struct SResult
+{
+	std::string name;
+	size_t frames;
+	double ns_per_frame;
+	double stage_ns[C2_STAGES];
+	double other_ns;
+	bool staged;		// codec results have a stage breakdown
+	double alias_db;	// resampler results have their alias rejection
+	double streams;		// receive results have the streams a core can decode and mix
+};
+
+// the resampler ratios the audio devices use
+static const int resample_rates[][2] = { { 8000, 44100 }, { 44100, 8000 }, { 8000, 48000 }, { 48000, 8000 } };
+
+// one talker of the synthetic corpus
+struct STalker
+{
+	double f0_low, f0_high;		// pitch range, Hz
+	double formant[3][3];		// three vowels, three formants each, Hz
+};
+
+static const STalker talkers[] = {
+	{  85.0, 155.0, { { 730.0, 1090.0, 2440.0 }, { 270.0, 2290.0, 3010.0 }, { 300.0,  870.0, 2240.0 } } },
+	{ 165.0, 255.0, { { 850.0, 1220.0, 2810.0 }, { 310.0, 2790.0, 3310.0 }, { 370.0,  950.0, 2670.0 } } },
+	{ 110.0, 190.0, { { 660.0, 1720.0, 2410.0 }, { 530.0, 1840.0, 2480.0 }, { 440.0, 1020.0, 2240.0 } } },
+	{ 250.0, 350.0, { {1030.0, 1370.0, 3170.0 }, { 370.0, 3200.0, 3730.0 }, { 430.0, 1170.0, 3260.0 } } },
+};
+
+static void SynthesiseTalker(std::vector<short> &out, const STalker &talker, double seconds, uint32_t seed)
+{
+	const int fs = 8000;
+	uint32_t r = seed;
+	auto rnd = [&r]() { r = r * 1664525u + 1013904223u; return (r >> 8) / double(1u << 24); };
+	double y1[3] = { 0.0 }, y2[3] = { 0.0 }, phase = 0.0;
+	size_t n = 0, total = size_t(seconds * fs);
+
+	while (n < total)
+	{
+		bool talk = rnd() < 0.6;
+		int len = int((talk ? 0.25 + 0.35 * rnd() : 0.15 + 0.5 * rnd()) * fs);
+		int vowel = int(rnd() * 3.0) % 3;
+		bool voiced = talk && rnd() < 0.8;
+		double f0s = talker.f0_low + (talker.f0_high - talker.f0_low) * rnd();
+		double f0e = f0s * (0.8 + 0.4 * rnd());
+		double amp = talk ? 3000.0 + 5000.0 * rnd() : 30.0;
+		for (int i=0; i<len && n<total; i++, n++)
+		{
+			double env = talk ? sin(M_PI * i / len) : 1.0;
+			double ex;
+			if (voiced)
+			{
+				phase += (f0s + (f0e - f0s) * i / len) / fs;
+				if (phase >= 1.0)
+					phase -= 1.0;
+				ex = ((phase < 0.4) ? sin(M_PI * phase / 0.4) : 0.0) - 0.3;
+			}
+			else
+				ex = rnd() - 0.5;
+			double s = 0.0;
+			for (int k=0; k<3; k++)
+			{
+				double rr = exp(-M_PI * (80.0 + 40.0 * k) / fs);
+				double y = ex + 2.0 * rr * cos(2.0 * M_PI * talker.formant[vowel][k] / fs) * y1[k] - rr * rr * y2[k];
+				y2[k] = y1[k];
+				y1[k] = y;
+				s += y / (k + 1);
+			}
+			double v = amp * env * s * 0.05 + (rnd() - 0.5) * 20.0;
+			out.push_back(short(std::max(-32767.0, std::min(32767.0, v))));
+		}
+	}
+}
+
+static bool ReadWav(const char *name, std::vector<short> &out)
+{
+	auto fp = fopen(name, "rb");
+	if (nullptr == fp)
+	{
+		std::cerr << "ERROR: can't open '" << name << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	std::vector<unsigned char> data;
+	unsigned char buf[4096];
+	size_t n;
+	while (0 < (n = fread(buf, 1, sizeof(buf), fp)))
+		data.insert(data.end(), buf, buf + n);
+	fclose(fp);
+
+	auto le = [&data](size_t p, int k) { uint32_t v = 0; while (k--) v = (v << 8) | data[p + k]; return v; };
+	if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4))
+	{
+		std::cerr << "ERROR: '" << name << "' is not a WAV file" << std::endl;
+		return true;
+	}
+	bool fmt_ok = false;
+	for (size_t p=12; p+8<=data.size(); )
+	{
+		uint32_t size = le(p+4, 4);
+		if (0 == memcmp(&data[p], "fmt ", 4) && p+24 <= data.size())
+			fmt_ok = (1 == le(p+8, 2) && 1 == le(p+10, 2) && 8000 == le(p+12, 4) && 16 == le(p+22, 2));
+		else if (0 == memcmp(&data[p], "data", 4) && fmt_ok)
+		{
+			size = std::min<size_t>(size, data.size() - p - 8);
+			for (size_t i=0; i+1<size; i+=2)
+				out.push_back(short(le(p+8+i, 2)));
+			return false;
+		}
+		p += 8 + size + (size & 1);
+	}
+	std::cerr << "ERROR: '" << name << "' is not 8000 Hz mono 16 bit PCM" << std::endl;
+	return true;
+}
+
+// best time of each frame over reps runs, then one profiled run
+static SResult Run(bool is_3200, bool encode, const std::vector<short> &speech, std::vector<unsigned char> &bits, int reps)
+{
+	SResult result;
+	result.name = std::string(encode ? "encode_" : "decode_") + (is_3200 ? "3200" : "1600");
+	result.staged = true;
+	result.alias_db = 0.0;
+	result.streams = 0.0;
+	const int spf = is_3200 ? 160 : 320;
+	const size_t nframes = encode ? speech.size() / spf : bits.size() / 8;
+	result.frames = nframes;
+	if (encode)
+		bits.resize(nframes * 8);
+
+	std::vector<double> best(nframes, 1e30);
+	std::vector<short> out(spf);
+	for (int rep=0; rep<reps; rep++)
+	{
+		CCodec2 c2(is_3200);
+		for (size_t i=0; i<nframes; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (encode)
+				c2.codec2_encode(&bits[i * 8], &speech[i * spf]);
+			else
+				c2.codec2_decode(out.data(), &bits[i * 8]);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			best[i] = std::min(best[i], ns);
+		}
+	}
+	double total = 0.0;
+	for (auto ns : best)
+		total += ns;
+	result.ns_per_frame = nframes ? total / nframes : 0.0;
+
+	CCodec2 c2(is_3200);
+	c2.codec2_profile_enable(true);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i=0; i<nframes; i++)
+	{
+		if (encode)
+			c2.codec2_encode(&bits[i * 8], &speech[i * spf]);
+		else
+			c2.codec2_decode(out.data(), &bits[i * 8]);
+	}
+	double profiled = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+	// scale the profiled run to the best whole frame time
+	const C2PROFILE &prof = c2.codec2_profile();
+	double scale = (0.0 < profiled) ? total / profiled : 0.0;
+	result.other_ns = result.ns_per_frame;
+	for (int s=0; s<C2_STAGES; s++)
+	{
+		result.stage_ns[s] = nframes ? prof.ns[s] * scale / nframes : 0.0;
+		result.other_ns -= result.stage_ns[s];
+	}
+	if (result.other_ns < 0.0)
+		result.other_ns = 0.0;
+	return result;
+}
+
+// amplitude of the tone at f Hz in n samples of x, Hann windowed
+static double ToneLevel(const std::vector<float> &x, size_t start, size_t n, double f, double fs)
+{
+	double re = 0.0, im = 0.0, wsum = 0.0;
+	for (size_t i=0; i<n; i++)
+	{
+		double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / n);
+		wsum += w;
+		re += w * x[start + i] * cos(2.0 * M_PI * f * i / fs);
+		im -= w * x[start + i] * sin(2.0 * M_PI * f * i / fs);
+	}
+	return 2.0 * sqrt(re * re + im * im) / wsum;
+}
+
+// Worst alias (going down) or image (going up) level in dB below a full
+// scale tone.  Down, the tones sweep from just past the output Nyquist
+// transition band to the input Nyquist; up, they sweep the pass band and
+// every image below the output Nyquist is measured.
+static double AliasRejection(int fin, int fout)
+{
+	const double ratio = double(fout) / fin;
+	const bool down = fin > fout;
+	const double amp = 0.5;
+	const size_t n = 2048;
+	double worst = -300.0;
+	for (double f=(down ? 0.525 * fout : 100.0); f<(down ? 0.5 * fin : 0.4 * fin); f+=125.0)
+	{
+		CResampler rs;
+		SDATA data;
+		std::vector<float> in(fin / 2), out(size_t(in.size() * ratio) + 64);
+		for (size_t i=0; i<in.size(); i++)
+			in[i] = float(amp * sin(2.0 * M_PI * f * i / fin));
+		data.data_in = in.data();
+		data.data_out = out.data();
+		data.input_frames = in.size();
+		data.output_frames = out.size();
+		data.end_of_input = false;
+		rs.SetRatio(data, ratio);
+		rs.Process(data);
+		const size_t start = data.output_frames_gen / 2 - n / 2;
+		if (down)
+		{
+			double alias = fabs(f - fout * round(f / fout));
+			worst = std::max(worst, 20.0 * log10(ToneLevel(out, start, n, alias, fout) / amp + 1e-30));
+		}
+		else
+		{
+			for (int k=1; k*fin-f<0.5*fout; k++)
+			{
+				for (double image : { k * fin - f, k * fin + f })
+					if (image < 0.5 * fout)
+						worst = std::max(worst, 20.0 * log10(ToneLevel(out, start, n, image, fout) / amp + 1e-30));
+			}
+		}
+	}
+	return -worst;
+}
+
+// 20 ms chunks, as the audio devices feed it, best time of each chunk
+static SResult RunResampler(int fin, int fout, bool polyphase, const std::vector<short> &speech, int reps)
+{
+	SResult result;
+	result.name = std::string(polyphase ? "resample_" : "resample_sinc_") + std::to_string(fin) + "_" + std::to_string(fout);
+	result.staged = false;
+	result.alias_db = polyphase ? AliasRejection(fin, fout) : 0.0;
+	result.streams = 0.0;
+	for (int s=0; s<C2_STAGES; s++)
+		result.stage_ns[s] = 0.0;
+
+	// the corpus at 8 kHz, otherwise noise of the same length
+	const double ratio = double(fout) / fin;
+	std::vector<float> in(size_t(speech.size() * double(fin) / 8000.0));
+	uint32_t r = 1;
+	for (size_t i=0; i<in.size(); i++)
+	{
+		r = r * 1664525u + 1013904223u;
+		in[i] = (8000 == fin) ? speech[i] / 32768.0f : (int32_t(r) >> 16) / 65536.0f;
+	}
+	const size_t chunk = fin / 50;
+	const size_t nframes = in.size() / chunk;
+	result.frames = nframes;
+
+	std::vector<float> out(size_t(chunk * ratio) + 64);
+	std::vector<double> best(nframes, 1e30);
+	for (int rep=0; rep<reps; rep++)
+	{
+		CResampler rs;
+		SDATA data;
+		data.data_out = out.data();
+		data.input_frames = chunk;
+		data.end_of_input = false;
+		rs.SetRatio(data, ratio, polyphase);
+		for (size_t i=0; i<nframes; i++)
+		{
+			data.data_in = &in[i * chunk];
+			data.output_frames = lrint((i + 1) * chunk * ratio) - lrint(i * chunk * ratio);
+			auto start = std::chrono::steady_clock::now();
+			rs.Process(data);
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			best[i] = std::min(best[i], ns);
+		}
+	}
+	double total = 0.0;
+	for (auto ns : best)
+		total += ns;
+	result.ns_per_frame = nframes ? total / nframes : 0.0;
+	result.other_ns = result.ns_per_frame;
+	return result;
+}
+
+// The transmit and receive paths of the application for one 20 ms frame
+// at a device rate: capture resampling, 3200 encode and decode, playback
+// resampling.  With short samples every stage boundary converts, with
+// float samples the only conversions are inside the codec.
+static SResult RunPipeline(int rate, bool use_float, const std::vector<short> &speech, int reps)
+{
+	SResult result;
+	result.name = std::string(use_float ? "pipeline_float_" : "pipeline_short_") + std::to_string(rate);
+	result.staged = false;
+	result.alias_db = 0.0;
+	result.streams = 0.0;
+	for (int s=0; s<C2_STAGES; s++)
+		result.stage_ns[s] = 0.0;
+
+	// the corpus at the device rate, as the device would deliver it
+	const int period = rate / 50;
+	const size_t nframes = speech.size() / 160;
+	result.frames = nframes;
+	std::vector<short> in_short(nframes * period);
+	std::vector<float> in_float(nframes * period);
+	for (size_t i=0; i<in_short.size(); i++)
+	{
+		in_short[i] = speech[i * 8000 / rate];
+		in_float[i] = in_short[i] / 32768.0f;
+	}
+
+	std::vector<double> best(nframes, 1e30);
+	for (int rep=0; rep<reps; rep++)
+	{
+		CCodec2 enc(true), dec(true);
+		CResampler shrink_rs, expand_rs;
+		SDATA shrink, expand;
+		float shrink_in[1000], shrink_out[160], expand_in[160], expand_out[1000];
+		shrink.data_in = shrink_in;
+		shrink.data_out = shrink_out;
+		shrink.input_frames = period;
+		shrink.output_frames = 160;
+		shrink.end_of_input = false;
+		shrink_rs.SetRatio(shrink, 8000.0 / rate);
+		expand.data_in = expand_in;
+		expand.data_out = expand_out;
+		expand.input_frames = 160;
+		expand.output_frames = period;
+		expand.end_of_input = false;
+		expand_rs.SetRatio(expand, rate / 8000.0);
+		const bool resampling = (8000 != rate);
+		short frame_short[160], out_short[1000];
+		float frame_float[160], out_float[1000];
+		unsigned char bits[8];
+
+		for (size_t i=0; i<nframes; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (use_float)
+			{
+				const float *capture = &in_float[i * period];
+				if (resampling)
+				{
+					shrink.data_in = const_cast<float *>(capture);
+					shrink.data_out = frame_float;
+					shrink_rs.Process(shrink);
+				}
+				enc.codec2_encode(bits, resampling ? frame_float : capture);
+				dec.codec2_decode(resampling ? expand_in : out_float, bits);
+				if (resampling)
+				{
+					expand.data_out = out_float;
+					expand_rs.Process(expand);
+				}
+			}
+			else
+			{
+				const short *capture = &in_short[i * period];
+				if (resampling)
+				{
+					shrink_rs.Short2Float(capture, shrink.data_in, period);
+					shrink_rs.Process(shrink);
+					shrink_rs.Float2Short(shrink.data_out, frame_short, 160);
+				}
+				enc.codec2_encode(bits, resampling ? frame_short : capture);
+				dec.codec2_decode(resampling ? frame_short : out_short, bits);
+				if (resampling)
+				{
+					expand_rs.Short2Float(frame_short, expand.data_in, 160);
+					expand_rs.Process(expand);
+					expand_rs.Float2Short(expand.data_out, out_short, period);
+				}
+			}
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			best[i] = std::min(best[i], ns);
+		}
+	}
+	double total = 0.0;
+	for (auto ns : best)
+		total += ns;
+	result.ns_per_frame = nframes ? total / nframes : 0.0;
+	result.other_ns = result.ns_per_frame;
+	return result;
+}
+
+// nstreams decoders, one frame each per mix period, each stream starting
+// at its own place in the frames, the sum at a gain of 1/sqrt(nstreams)
+static SResult RunStreams(bool is_3200, int nstreams, const std::vector<unsigned char> &bits, int reps)
+{
+	SResult result;
+	result.name = std::string("streams_") + (is_3200 ? "3200_" : "1600_") + std::to_string(nstreams);
+	result.staged = false;
+	result.alias_db = 0.0;
+	for (int s=0; s<C2_STAGES; s++)
+		result.stage_ns[s] = 0.0;
+	const int spf = is_3200 ? 160 : 320;
+	const size_t nframes = bits.size() / 8;
+	result.frames = nframes;
+
+	std::vector<double> best(nframes, 1e30);
+	std::vector<short> audio(spf), out(spf);
+	std::vector<float> sum(spf);
+	const float gain = 1.0f / sqrtf(float(nstreams));
+	for (int rep=0; rep<reps; rep++)
+	{
+		std::vector<CCodec2 *> c2;
+		for (int n=0; n<nstreams; n++)
+			c2.push_back(new CCodec2(is_3200));
+		for (size_t i=0; i<nframes; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::fill(sum.begin(), sum.end(), 0.0f);
+			for (int n=0; n<nstreams; n++)
+			{
+				c2[n]->codec2_decode(audio.data(), &bits[((i + n * nframes / nstreams) % nframes) * 8]);
+				for (int k=0; k<spf; k++)
+					sum[k] += audio[k] * gain;
+			}
+			for (int k=0; k<spf; k++)
+				out[k] = (sum[k] >= 32767.0f) ? 32767 : ((sum[k] <= -32768.0f) ? -32768 : short(lrintf(sum[k])));
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			best[i] = std::min(best[i], ns);
+		}
+		for (auto p : c2)
+			delete p;
+	}
+	double total = 0.0;
+	for (auto ns : best)
+		total += ns;
+	result.ns_per_frame = nframes ? total / nframes : 0.0;
+	result.other_ns = result.ns_per_frame;
+	result.streams = (0.0 < result.ns_per_frame) ? nstreams * spf * 125000.0 / result.ns_per_frame : 0.0;
+	return result;
+}
+
+// the ns one span costs, the best of reps runs of a million each
+static SResult RunTrace(bool on, int reps)
+{
+	SResult result;
+	result.name = on ? "trace_span_on" : "trace_span_off";
+	result.staged = false;
+	result.alias_db = 0.0;
+	result.streams = 0.0;
+	for (int s=0; s<C2_STAGES; s++)
+		result.stage_ns[s] = 0.0;
+	const size_t nspans = 1000000;
+	result.frames = nspans;
+	CTrace::Enable(on);
+	double best = 1e30;
+	for (int rep=0; rep<reps; rep++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i=0; i<nspans; i++)
+		{
+			TRACE_SPAN("bench");
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+	}
+	CTrace::Enable(false);
+	result.ns_per_frame = best / nspans;
+	result.other_ns = result.ns_per_frame;
+	return result;
+}
+
+static std::string Json(const std::vector<SResult> &results, double seconds, const char *source)
+{
+	std::string json;
+	char line[256];
+	snprintf(line, sizeof(line), "{\n  \"benchmark\": \"yamvoice-bench\",\n  \"version\": %d,\n", BENCH_VERSION);
+	json.append(line);
+	snprintf(line, sizeof(line), "  \"corpus\": { \"source\": \"%s\", \"seconds\": %.2f },\n", source, seconds);
+	json.append(line);
+#ifdef CODEC2_FIXED
+	json.append("  \"fixed_decoder\": true,\n");
+#else
+	json.append("  \"fixed_decoder\": false,\n");
+#endif
+	json.append("  \"results\": {\n");
+	for (size_t r=0; r<results.size(); r++)
+	{
+		const SResult &res = results[r];
+		snprintf(line, sizeof(line), "    \"%s\": {\n      \"frames\": %zu,\n      \"ns_per_frame\": %.0f,\n      \"frames_per_sec\": %.0f,\n",
+			res.name.c_str(), res.frames, res.ns_per_frame, (0.0 < res.ns_per_frame) ? 1e9 / res.ns_per_frame : 0.0);
+		json.append(line);
+		if (! res.staged)
+		{
+			if (0.0 < res.alias_db)
+				snprintf(line, sizeof(line), "      \"alias_rejection_db\": %.1f\n    }%s\n", res.alias_db, (r + 1 < results.size()) ? "," : "");
+			else if (0.0 < res.streams)
+				snprintf(line, sizeof(line), "      \"streams_per_core\": %.1f\n    }%s\n", res.streams, (r + 1 < results.size()) ? "," : "");
+			else
+				snprintf(line, sizeof(line), "      \"alias_rejection_db\": null\n    }%s\n", (r + 1 < results.size()) ? "," : "");
+			json.append(line);
+			continue;
+		}
+		json.append("      \"stage_ns_per_frame\": {\n");
+		for (int s=0; s<C2_STAGES; s++)
+		{
+			snprintf(line, sizeof(line), "        \"%s\": %.0f,\n", CCodec2::codec2_stage_name(s), res.stage_ns[s]);
+			json.append(line);
+		}
+		snprintf(line, sizeof(line), "        \"other\": %.0f\n      }\n    }%s\n", res.other_ns, (r + 1 < results.size()) ? "," : "");
+		json.append(line);
+	}
+	json.append("  }\n}\n");
+	return json;
+}
+
+// the baseline is a file this program wrote, so it is enough to find
+// the key inside the named result
+static bool FindNumber(const std::string &json, const std::string &result, const std::string &key, double &value)
+{
+	auto pos = json.find("\"" + result + "\"");
+	if (std::string::npos == pos)
+		return false;
+	auto end = json.find("\n    }", pos);
+	pos = json.find("\"" + key + "\":", pos);
+	if (std::string::npos == pos || pos > end)
+		return false;
+	value = atof(json.c_str() + pos + key.size() + 3);
+	return true;
+}
+
+// returns the number of regressions beyond the threshold
+static int Compare(const std::vector<SResult> &results, const std::string &baseline, double threshold)
+{
+	int regressions = 0;
+	fprintf(stderr, "%-24s %-28s %12s %12s %8s\n", "result", "stage", "baseline ns", "now ns", "change");
+	for (auto &res : results)
+	{
+		for (int s=-1; s<=C2_STAGES; s++)
+		{
+			const char *key = (s < 0) ? "ns_per_frame" : ((s < C2_STAGES) ? CCodec2::codec2_stage_name(s) : "other");
+			double now = (s < 0) ? res.ns_per_frame : ((s < C2_STAGES) ? res.stage_ns[s] : res.other_ns);
+			double then;
+			if (! FindNumber(baseline, res.name, key, then) || (0.0 == then && 0.0 == now))
+				continue;
+			double change = (0.0 < then) ? 100.0 * (now - then) / then : 0.0;
+			// only the whole frame time counts as a regression, stages are for finding out why
+			bool bad = (s < 0 && change > threshold);
+			if (bad)
+				regressions++;
+			fprintf(stderr, "%-24s %-28s %12.0f %12.0f %+7.1f%%%s\n", res.name.c_str(), (s < 0) ? "(whole frame)" : key, then, now, change, bad ? "  REGRESSION" : "");
+		}
+	}
+	return regressions;
+}
+
+static const char *golden_name[] = { "input.raw", "3200.c2", "3200.raw", "1600.c2", "1600.raw" };
+
+// The decoder budgets of a golden check, [0] 3200 and [1] 1600.  The
+// float decoder must reproduce the recorded output exactly.  The fixed
+// point decoder gets about 26 and 19 dB against a float recording of the
+// default corpus, the budgets leave it 6 and 2 dB of that.
+#ifdef CODEC2_FIXED
+static const double decode_snr[2] = { 20.0, 17.0 };
+#define DECODE_MAX_ERROR 4096
+#else
+static const double decode_snr[2] = { INFINITY, INFINITY };
+#define DECODE_MAX_ERROR 0
+#endif
+
+static bool WriteFile(const std::string &name, const void *data, size_t size)
+{
+	auto fp = fopen(name.c_str(), "wb");
+	if (nullptr == fp || size != fwrite(data, 1, size, fp) || fclose(fp))
+	{
+		std::cerr << "ERROR: can't write '" << name << "'" << std::endl;
+		if (fp)
+			fclose(fp);
+		return true;
+	}
+	return false;
+}
+
+template <class V> static bool ReadFile(const std::string &name, std::vector<V> &data)
+{
+	auto fp = fopen(name.c_str(), "rb");
+	if (nullptr == fp)
+	{
+		std::cerr << "ERROR: can't open '" << name << "': " << strerror(errno) << std::endl;
+		return true;
+	}
+	V buf[2048];
+	size_t n;
+	data.clear();
+	while (0 < (n = fread(buf, sizeof(V), 2048, fp)))
+		data.insert(data.end(), buf, buf + n);
+	fclose(fp);
+	return false;
+}
+
+static void Encode(bool is_3200, const std::vector<short> &speech, std::vector<unsigned char> &bits)
+{
+	const size_t spf = is_3200 ? 160 : 320;
+	CCodec2 c2(is_3200);
+	bits.resize(speech.size() / spf * 8);
+	for (size_t i=0; i<bits.size()/8; i++)
+		c2.codec2_encode(&bits[i * 8], &speech[i * spf]);
+}
+
+static void Decode(bool is_3200, const std::vector<unsigned char> &bits, std::vector<short> &speech)
+{
+	const size_t spf = is_3200 ? 160 : 320;
+	CCodec2 c2(is_3200);
+	speech.resize(bits.size() / 8 * spf);
+	for (size_t i=0; i<bits.size()/8; i++)
+		c2.codec2_decode(&speech[i * spf], &bits[i * 8]);
+}
+
+// Encodes and decodes speech straight through, then again with the
+// state saved partway, restored into a fresh instance and carried on
+// there.  Both must give the same bytes.  Returns the failed checks.
+static int StateCheck(bool is_3200, const std::vector<short> &speech)
+{
+	const char *mode = is_3200 ? "3200" : "1600";
+	const size_t spf = is_3200 ? 160 : 320;
+	std::vector<unsigned char> bits;
+	std::vector<short> out;
+	Encode(is_3200, speech, bits);
+	Decode(is_3200, bits, out);
+	const size_t nframes = bits.size() / 8;
+	if (nframes < 4)
+		return 0;
+	int failed = 0;
+	for (size_t at : { size_t(1), size_t(37), nframes / 2, nframes - 3 })
+	{
+		if (at >= nframes)
+			continue;
+		std::vector<unsigned char> bits2(bits.size()), state;
+		std::vector<short> out2(out.size());
+		bool restored = true;
+		for (int part : { CODEC2_STATE_ENCODER, CODEC2_STATE_DECODER })
+		{
+			CCodec2 before(is_3200), after(is_3200);
+			for (size_t i=0; i<at; i++)
+			{
+				if (CODEC2_STATE_ENCODER == part)
+					before.codec2_encode(&bits2[i * 8], &speech[i * spf]);
+				else
+					before.codec2_decode(&out2[i * spf], &bits[i * 8]);
+			}
+			state.resize(before.codec2_state_bytes(part));
+			before.codec2_save_state(state.data(), part);
+			restored = after.codec2_restore_state(state.data(), int(state.size())) && restored;
+			for (size_t i=at; i<nframes; i++)
+			{
+				if (CODEC2_STATE_ENCODER == part)
+					after.codec2_encode(&bits2[i * 8], &speech[i * spf]);
+				else
+					after.codec2_decode(&out2[i * spf], &bits[i * 8]);
+			}
+		}
+		const bool pass = restored && bits2 == bits && out2 == out;
+		fprintf(stderr, "state_%s: restored at frame %zu of %zu, %s: %s\n", mode, at, nframes,
+			restored ? ((bits2 == bits) ? ((out2 == out) ? "bit exact" : "decoder output differs") : "encoder frames differ") : "restore refused", pass ? "PASS" : "FAIL");
+		failed += pass ? 0 : 1;
+	}
+	return failed;
+}
+
+static bool GoldenRecord(const std::string &dir, const std::vector<short> &speech)
+{
+	if (WriteFile(dir + "/" + golden_name[0], speech.data(), speech.size() * sizeof(short)))
+		return true;
+	for (int m=0; m<2; m++)
+	{
+		std::vector<unsigned char> bits;
+		std::vector<short> out;
+		Encode(0 == m, speech, bits);
+		Decode(0 == m, bits, out);
+		if (WriteFile(dir + "/" + golden_name[1 + 2 * m], bits.data(), bits.size()) || WriteFile(dir + "/" + golden_name[2 + 2 * m], out.data(), out.size() * sizeof(short)))
+			return true;
+		fprintf(stderr, "%s: %zu frames recorded\n", (0 == m) ? "3200" : "1600", bits.size() / 8);
+	}
+	return false;
+}
+
+// returns the number of failed checks, or -1 if the set can't be read
+static int GoldenCheck(const std::string &dir, double min_snr, int max_error, double min_alias)
+{
+	std::vector<short> speech;
+	if (ReadFile(dir + "/" + golden_name[0], speech))
+		return -1;
+	int failed = 0;
+	for (int m=0; m<2; m++)
+	{
+		const char *mode = (0 == m) ? "3200" : "1600";
+		std::vector<unsigned char> golden_bits, bits;
+		std::vector<short> golden_out, out;
+		if (ReadFile(dir + "/" + golden_name[1 + 2 * m], golden_bits) || ReadFile(dir + "/" + golden_name[2 + 2 * m], golden_out))
+			return -1;
+
+		Encode(0 == m, speech, bits);
+		size_t bad = 0, first = 0;
+		for (size_t i=0; i<bits.size()/8; i++)
+		{
+			if (i*8+8 > golden_bits.size() || memcmp(&bits[i * 8], &golden_bits[i * 8], 8))
+			{
+				if (0 == bad++)
+					first = i;
+			}
+		}
+		bool pass = (0 == bad && bits.size() == golden_bits.size());
+		if (pass)
+			fprintf(stderr, "encode_%s: %zu frames bit exact: PASS\n", mode, bits.size() / 8);
+		else
+			fprintf(stderr, "encode_%s: %zu of %zu frames differ, first at frame %zu: FAIL\n", mode, bad, bits.size() / 8, first);
+		failed += pass ? 0 : 1;
+
+		// decode the recorded frames, so a decoder change is judged on its own
+		Decode(0 == m, golden_bits, out);
+		if (out.size() != golden_out.size())
+		{
+			fprintf(stderr, "decode_%s: %zu samples, expected %zu: FAIL\n", mode, out.size(), golden_out.size());
+			failed++;
+			continue;
+		}
+		double signal = 0.0, noise = 0.0;
+		int worst = 0;
+		for (size_t i=0; i<out.size(); i++)
+		{
+			double e = double(out[i]) - golden_out[i];
+			signal += double(golden_out[i]) * golden_out[i];
+			noise += e * e;
+			worst = std::max(worst, abs(int(e)));
+		}
+		double snr = (0.0 < noise) ? 10.0 * log10(signal / noise) : INFINITY;
+		const double snr_budget = (0.0 <= min_snr) ? min_snr : decode_snr[m];
+		pass = (snr >= snr_budget && worst <= max_error);
+		char snr_text[80];
+		if (std::isinf(snr_budget))
+			snprintf(snr_text, sizeof(snr_text), "SNR %.1f dB (bit exact)", snr);
+		else
+			snprintf(snr_text, sizeof(snr_text), "SNR %.1f dB (budget %.1f, margin %+.1f)", snr, snr_budget, snr - snr_budget);
+		fprintf(stderr, "decode_%s: %s, max error %d (budget %d, margin %d): %s\n", mode, snr_text, worst, max_error, max_error - worst, pass ? "PASS" : "FAIL");
+		failed += pass ? 0 : 1;
+
+		failed += StateCheck(0 == m, speech);
+	}
+	for (auto &rates : resample_rates)
+	{
+		double db = AliasRejection(rates[0], rates[1]);
+		bool pass = (db >= min_alias);
+		fprintf(stderr, "resample_%d_%d: alias rejection %.1f dB (budget %.1f): %s\n", rates[0], rates[1], db, min_alias, pass ? "PASS" : "FAIL");
+		failed += pass ? 0 : 1;
+	}
+	return failed;
+}
+
+static void Usage(const char *name)
+{
+	std::cerr << "Usage: " << name << " [options] [file.wav...]\n"
+		"Times the Codec2 3200 and 1600 encoders and decoders, results are JSON.\n"
+		"  -s SECONDS   length of the built in corpus per talker, default 15\n"
+		"  -n RUNS      timed runs, the best time of each frame is used, default 5\n"
+		"  -o FILE      write the JSON here instead of stdout\n"
+		"  -b FILE      compare with a baseline JSON from an earlier run\n"
+		"  -t PERCENT   slow down that counts as a regression, default 5\n"
+		"  -R DIR       record a golden vector set in DIR instead of timing\n"
+		"  -C DIR       check the codec against the golden vector set in DIR\n"
+		"  -q DB        lowest decoder SNR that passes a check, default bit exact,\n"
+		"               or 20 at 3200 and 17 at 1600 with the fixed point decoder\n"
+		"  -x ERROR     largest decoder sample error that passes a check, default 0,\n"
+		"               or 4096 with the fixed point decoder\n"
+		"  -a DB        lowest resampler alias rejection that passes a check, default 90\n"
+		"  -T NS        largest cost of a trace span, with tracing on, default 250\n";
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = 15.0, threshold = 5.0, min_snr = -1.0, min_alias = 90.0, max_span = 250.0;
+	int reps = 5, max_error = DECODE_MAX_ERROR, c;
+	std::string outname, basename, record, check;
+	while (-1 != (c = getopt(argc, argv, "s:n:o:b:t:R:C:q:x:a:T:h")))
+	{
+		switch (c)
+		{
+			case 's':
+				seconds = atof(optarg);
+				break;
+			case 'n':
+				reps = std::max(1, atoi(optarg));
+				break;
+			case 'o':
+				outname.assign(optarg);
+				break;
+			case 'b':
+				basename.assign(optarg);
+				break;
+			case 't':
+				threshold = atof(optarg);
+				break;
+			case 'R':
+				record.assign(optarg);
+				break;
+			case 'C':
+				check.assign(optarg);
+				break;
+			case 'q':
+				min_snr = atof(optarg);
+				break;
+			case 'x':
+				max_error = atoi(optarg);
+				break;
+			case 'a':
+				min_alias = atof(optarg);
+				break;
+			case 'T':
+				max_span = atof(optarg);
+				break;
+			default:
+				Usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (! check.empty())
+	{
+		int failed = GoldenCheck(check, min_snr, max_error, min_alias);
+		if (failed)
+		{
+			if (0 < failed)
+				std::cerr << failed << " golden vector check(s) failed" << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	std::vector<short> speech;
+	const char *source = "synthetic";
+	if (optind < argc)
+	{
+		source = "files";
+		for (int i=optind; i<argc; i++)
+			if (ReadWav(argv[i], speech))
+				return EXIT_FAILURE;
+	}
+	else
+	{
+		for (unsigned t=0; t<sizeof(talkers)/sizeof(talkers[0]); t++)
+			SynthesiseTalker(speech, talkers[t], seconds, t + 1);
+	}
+	if (speech.size() < 320)
+	{
+		std::cerr << "ERROR: not enough speech to time" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (! record.empty())
+		return GoldenRecord(record, speech) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	std::vector<SResult> results;
+	for (bool is_3200 : { true, false })
+	{
+		std::vector<unsigned char> bits;
+		results.push_back(Run(is_3200, true, speech, bits, reps));
+		results.push_back(Run(is_3200, false, speech, bits, reps));
+		for (int nstreams : { 1, 8 })
+			results.push_back(RunStreams(is_3200, nstreams, bits, reps));
+	}
+	for (auto &rates : resample_rates)
+	{
+		results.push_back(RunResampler(rates[0], rates[1], true, speech, reps));
+		results.push_back(RunResampler(rates[0], rates[1], false, speech, reps));
+	}
+	for (int rate : { 8000, 48000 })
+	{
+		results.push_back(RunPipeline(rate, false, speech, reps));
+		results.push_back(RunPipeline(rate, true, speech, reps));
+	}
+	results.push_back(RunTrace(false, reps));
+	results.push_back(RunTrace(true, reps));
+	const bool span_pass = results.back().ns_per_frame <= max_span;
+	fprintf(stderr, "trace_span_on: %.1f ns per span (budget %.1f): %s\n", results.back().ns_per_frame, max_span, span_pass ? "PASS" : "FAIL");
+
+	std::string json = Json(results, speech.size() / 8000.0, source);
+	if (outname.empty())
+		fputs(json.c_str(), stdout);
+	else
+	{
+		auto fp = fopen(outname.c_str(), "w");
+		if (nullptr == fp || EOF == fputs(json.c_str(), fp) || fclose(fp))
+		{
+			std::cerr << "ERROR: can't write '" << outname << "'" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (! basename.empty())
+	{
+		auto fp = fopen(basename.c_str(), "r");
+		if (nullptr == fp)
+		{
+			std::cerr << "ERROR: can't open '" << basename << "': " << strerror(errno) << std::endl;
+			return EXIT_FAILURE;
+		}
+		std::string baseline;
+		char buf[4096];
+		size_t n;
+		while (0 < (n = fread(buf, 1, sizeof(buf), fp)))
+			baseline.append(buf, n);
+		fclose(fp);
+#ifdef CODEC2_FIXED
+		if (std::string::npos == baseline.find("\"fixed_decoder\": true"))
+#else
+		if (std::string::npos == baseline.find("\"fixed_decoder\": false"))
+#endif
+			std::cerr << "WARNING: the baseline was built with a different decoder, the decode times are not comparable" << std::endl;
+		if (Compare(results, baseline, threshold))
+			return EXIT_FAILURE;
+	}
+	return span_pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
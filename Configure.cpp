@@ -21,9 +21,28 @@
 #include <iomanip>
 #include <fstream>
 #include <cstring>
+#include <cstdlib>
 
 #include "Configure.h"
 
+static EQueuePolicy QueuePolicy(const char *val)
+{
+	if (0 == strcmp(val, "Block"))
+		return EQueuePolicy::block;
+	if (0 == strcmp(val, "Drop"))
+		return EQueuePolicy::drop_oldest;
+	return EQueuePolicy::compress;
+}
+
+static const char *QueuePolicyName(EQueuePolicy policy)
+{
+	if (EQueuePolicy::block == policy)
+		return "Block";
+	if (EQueuePolicy::drop_oldest == policy)
+		return "Drop";
+	return "Compress";
+}
+
 void CConfigure::SetDefaultValues()
 {
 	// M17
@@ -35,6 +54,19 @@ void CConfigure::SetDefaultValues()
 	// audio
 	data.sAudioIn.assign("default");
 	data.sAudioOut.assign("default");
+	data.eEncoderEffort = ECodecEffort::full;
+	data.bSilenceDetect = false;
+	data.bEncoderPipeline = false;
+	data.bAudioMmap = false;
+	data.bAudioFast = false;
+	data.bRealTime = false;
+	data.iRealTimePriority = 70;
+	data.iCaptureCPU = data.iEncodeCPU = data.iDecodeCPU = data.iPlaybackCPU = -1;
+	data.iPreRoll = 0;
+	data.iRxStreams = 4;
+	data.iTxQueue = 200;
+	data.iRxQueue = 600;
+	data.eTxQueuePolicy = data.eRxQueuePolicy = EQueuePolicy::compress;
 #ifndef NO_DHT
 	data.sBootstrap.assign("xrf757.openquad.net");
 #endif
@@ -80,6 +112,45 @@ void CConfigure::ReadData()
 			data.sAudioIn.assign(val);
 		} else if (0 == strcmp(key, "AudioOutput")) {
 			data.sAudioOut.assign(val);
+		} else if (0 == strcmp(key, "EncoderEffort")) {
+			if (0 == strcmp(val, "Reduced"))
+				data.eEncoderEffort = ECodecEffort::reduced;
+			else if (0 == strcmp(val, "Low"))
+				data.eEncoderEffort = ECodecEffort::low;
+			else
+				data.eEncoderEffort = ECodecEffort::full;
+		} else if (0 == strcmp(key, "SilenceDetect")) {
+			data.bSilenceDetect = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "EncoderPipeline")) {
+			data.bEncoderPipeline = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioMmap")) {
+			data.bAudioMmap = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "AudioFast")) {
+			data.bAudioFast = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RealTime")) {
+			data.bRealTime = IS_TRUE(*val);
+		} else if (0 == strcmp(key, "RealTimePriority")) {
+			data.iRealTimePriority = atoi(val);
+		} else if (0 == strcmp(key, "CaptureCPU")) {
+			data.iCaptureCPU = atoi(val);
+		} else if (0 == strcmp(key, "EncodeCPU")) {
+			data.iEncodeCPU = atoi(val);
+		} else if (0 == strcmp(key, "DecodeCPU")) {
+			data.iDecodeCPU = atoi(val);
+		} else if (0 == strcmp(key, "PlaybackCPU")) {
+			data.iPlaybackCPU = atoi(val);
+		} else if (0 == strcmp(key, "PreRoll")) {
+			data.iPreRoll = atoi(val);
+		} else if (0 == strcmp(key, "RxStreams")) {
+			data.iRxStreams = atoi(val);
+		} else if (0 == strcmp(key, "TxQueue")) {
+			data.iTxQueue = atoi(val);
+		} else if (0 == strcmp(key, "TxQueuePolicy")) {
+			data.eTxQueuePolicy = QueuePolicy(val);
+		} else if (0 == strcmp(key, "RxQueue")) {
+			data.iRxQueue = atoi(val);
+		} else if (0 == strcmp(key, "RxQueuePolicy")) {
+			data.eRxQueuePolicy = QueuePolicy(val);
 		} else if (0 == strcmp(key, "M17SourceCallsign")) {
 			data.sM17SourceCallsign.assign(val);
 		} else if (0 == strcmp(key, "M17VoiceOnly")) {
@@ -121,6 +192,30 @@ void CConfigure::WriteData()
 	// audio
 	file << "AudioInput='" << data.sAudioIn << "'" << std::endl;
 	file << "AudioOutput='" << data.sAudioOut << "'" << std::endl;
+	file << "EncoderEffort=";
+	if (data.eEncoderEffort == ECodecEffort::reduced)
+		file << "Reduced";
+	else if (data.eEncoderEffort == ECodecEffort::low)
+		file << "Low";
+	else
+		file << "Full";
+	file << std::endl;
+	file << "SilenceDetect=" << (data.bSilenceDetect ? "true" : "false") << std::endl;
+	file << "EncoderPipeline=" << (data.bEncoderPipeline ? "true" : "false") << std::endl;
+	file << "AudioMmap=" << (data.bAudioMmap ? "true" : "false") << std::endl;
+	file << "AudioFast=" << (data.bAudioFast ? "true" : "false") << std::endl;
+	file << "RealTime=" << (data.bRealTime ? "true" : "false") << std::endl;
+	file << "RealTimePriority=" << data.iRealTimePriority << std::endl;
+	file << "CaptureCPU=" << data.iCaptureCPU << std::endl;
+	file << "EncodeCPU=" << data.iEncodeCPU << std::endl;
+	file << "DecodeCPU=" << data.iDecodeCPU << std::endl;
+	file << "PlaybackCPU=" << data.iPlaybackCPU << std::endl;
+	file << "PreRoll=" << data.iPreRoll << std::endl;
+	file << "RxStreams=" << data.iRxStreams << std::endl;
+	file << "TxQueue=" << data.iTxQueue << std::endl;
+	file << "TxQueuePolicy=" << QueuePolicyName(data.eTxQueuePolicy) << std::endl;
+	file << "RxQueue=" << data.iRxQueue << std::endl;
+	file << "RxQueuePolicy=" << QueuePolicyName(data.eRxQueuePolicy) << std::endl;
 #ifndef NO_DHT
 	// DHT
 	file << "DHTBootstrap='" << data.sBootstrap << "'" << std::endl;
@@ -139,6 +234,23 @@ void CConfigure::CopyFrom(const CFGDATA &from)
 	// audio
 	data.sAudioIn.assign(from.sAudioIn);
 	data.sAudioOut.assign(from.sAudioOut);
+	data.eEncoderEffort = from.eEncoderEffort;
+	data.bSilenceDetect = from.bSilenceDetect;
+	data.bEncoderPipeline = from.bEncoderPipeline;
+	data.bAudioMmap = from.bAudioMmap;
+	data.bAudioFast = from.bAudioFast;
+	data.bRealTime = from.bRealTime;
+	data.iRealTimePriority = from.iRealTimePriority;
+	data.iCaptureCPU = from.iCaptureCPU;
+	data.iEncodeCPU = from.iEncodeCPU;
+	data.iDecodeCPU = from.iDecodeCPU;
+	data.iPlaybackCPU = from.iPlaybackCPU;
+	data.iPreRoll = from.iPreRoll;
+	data.iRxStreams = from.iRxStreams;
+	data.iTxQueue = from.iTxQueue;
+	data.iRxQueue = from.iRxQueue;
+	data.eTxQueuePolicy = from.eTxQueuePolicy;
+	data.eRxQueuePolicy = from.eRxQueuePolicy;
 #ifndef NO_DHT
 	// DHT
 	data.sBootstrap.assign(from.sBootstrap);
@@ -156,6 +268,23 @@ void CConfigure::CopyTo(CFGDATA &to)
 	// audio
 	to.sAudioIn.assign(data.sAudioIn);
 	to.sAudioOut.assign(data.sAudioOut);
+	to.eEncoderEffort = data.eEncoderEffort;
+	to.bSilenceDetect = data.bSilenceDetect;
+	to.bEncoderPipeline = data.bEncoderPipeline;
+	to.bAudioMmap = data.bAudioMmap;
+	to.bAudioFast = data.bAudioFast;
+	to.bRealTime = data.bRealTime;
+	to.iRealTimePriority = data.iRealTimePriority;
+	to.iCaptureCPU = data.iCaptureCPU;
+	to.iEncodeCPU = data.iEncodeCPU;
+	to.iDecodeCPU = data.iDecodeCPU;
+	to.iPlaybackCPU = data.iPlaybackCPU;
+	to.iPreRoll = data.iPreRoll;
+	to.iRxStreams = data.iRxStreams;
+	to.iTxQueue = data.iTxQueue;
+	to.iRxQueue = data.iRxQueue;
+	to.eTxQueuePolicy = data.eTxQueuePolicy;
+	to.eRxQueuePolicy = data.eRxQueuePolicy;
 #ifndef NO_DHT
 	// DHT
 	to.sBootstrap.assign(data.sBootstrap);
@@ -20,17 +20,27 @@
 
 #include <string>
 
+#include "TemplateClasses.h"
+
 #define IS_TRUE(a) ((a)=='t' || (a)=='T' || (a)=='1')
 
 enum class EInternetType { ipv4only, ipv6only, dualstack };
+enum class ECodecEffort { full, reduced, low };
 
 using CFGDATA = struct CFGData_struct {
 	std::string sAudioIn, sAudioOut, sM17SourceCallsign;
 #ifndef NO_DHT
 	std::string sBootstrap;
 #endif
-	bool bVoiceOnlyEnable;
+	bool bVoiceOnlyEnable, bSilenceDetect, bEncoderPipeline, bAudioMmap, bAudioFast, bRealTime;
+	int iRealTimePriority;	// SCHED_FIFO priority of the capture and playback threads
+	int iCaptureCPU, iEncodeCPU, iDecodeCPU, iPlaybackCPU;	// -1 is any CPU
+	int iPreRoll;	// ms of audio kept from before PTT, 0 opens the mic on PTT
+	int iRxStreams;	// received streams played at once, mixed
+	int iTxQueue, iRxQueue;	// ms of audio a pipeline queue holds before its policy applies
+	EQueuePolicy eTxQueuePolicy, eRxQueuePolicy;
 	EInternetType eNetType;
+	ECodecEffort eEncoderEffort;
 	char cModule;
 };
 
@@ -0,0 +1,104 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+#include "DirWatch.h"
+
+bool CDirWatch::Open(const std::string &dir)
+{
+	Close();
+#ifdef __linux__
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		std::cerr << "ERROR: inotify_init1() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	// a file written in place or moved in, both are done when seen
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		std::cerr << "ERROR: can't watch " << dir << ": " << strerror(errno) << std::endl;
+		Close();
+		return true;
+	}
+#else
+	fd = kqueue();
+	if (fd < 0) {
+		std::cerr << "ERROR: kqueue() failed: " << strerror(errno) << std::endl;
+		return true;
+	}
+	dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) {
+		std::cerr << "ERROR: can't watch " << dir << ": " << strerror(errno) << std::endl;
+		Close();
+		return true;
+	}
+	struct kevent ev;
+	EV_SET(&ev, dirfd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE, 0, nullptr);
+	if (kevent(fd, &ev, 1, nullptr, 0, nullptr) < 0) {
+		std::cerr << "ERROR: can't watch " << dir << ": " << strerror(errno) << std::endl;
+		Close();
+		return true;
+	}
+#endif
+	return false;
+}
+
+void CDirWatch::Close()
+{
+	if (dirfd >= 0)
+		close(dirfd);
+	dirfd = -1;
+	if (fd >= 0)
+		close(fd);
+	fd = -1;
+}
+
+bool CDirWatch::Changed(const std::string &name)
+{
+	bool changed = false;
+#ifdef __linux__
+	alignas(struct inotify_event) char buf[4096];
+	ssize_t len;
+	while ((len = read(fd, buf, sizeof(buf))) > 0) {
+		for (char *p = buf; p < buf + len; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)p;
+			if (ev->len && 0 == name.compare(ev->name))
+				changed = true;
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+#else
+	struct kevent ev;
+	const struct timespec now = { 0, 0 };
+	while (kevent(fd, nullptr, 0, &ev, 1, &now) > 0)
+		changed = true;
+#endif
+	return changed;
+}
@@ -0,0 +1,42 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <string>
+
+// Tells when files appear in a directory, without looking for them.
+// Linux uses inotify, the BSDs a kqueue on the directory.  GetFD() is
+// readable when something happened, for select().
+
+class CDirWatch
+{
+public:
+	CDirWatch() : fd(-1), dirfd(-1) {}
+	~CDirWatch() { Close(); }
+	bool Open(const std::string &dir);	// returns true on failure
+	void Close();
+	int GetFD() const { return fd; }
+	// Reads what happened, true if name may have been written.  The
+	// kqueue only says that the directory changed, that counts for any name.
+	bool Changed(const std::string &name);
+
+private:
+	int fd;
+	int dirfd;	// kqueue only, the directory watched
+};
@@ -0,0 +1,65 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include "DriftEstimator.h"
+
+#define DRIFT_PERIOD 0.02	// seconds between updates
+#define DRIFT_SETTLE 100	// periods before the target is taken
+#define DRIFT_SMOOTH 0.01	// 2 s time constant, averages out the packet jitter
+#define DRIFT_KP     0.05	// speed-up per second of latency error
+#define DRIFT_KI     (DRIFT_KP * DRIFT_KP / 4.0)	// critically damped
+#define DRIFT_LIMIT  1.0e-3	// 1000 ppm, 1.7 cents of pitch at most
+
+void CDriftEstimator::Reset()
+{
+	drift = 0.0;
+	Rebase();
+}
+
+void CDriftEstimator::Rebase()
+{
+	smooth = target = -1.0;
+	periods = -DRIFT_SETTLE;
+}
+
+static double clamp(double x)
+{
+	if (x > DRIFT_LIMIT)
+		return DRIFT_LIMIT;
+	if (x < -DRIFT_LIMIT)
+		return -DRIFT_LIMIT;
+	return x;
+}
+
+double CDriftEstimator::Update(double latency)
+{
+	if (smooth < 0.0)
+		smooth = latency;
+	else
+		smooth += DRIFT_SMOOTH * (latency - smooth);
+
+	if (periods < 0) {
+		if (0 == ++periods)
+			target = smooth;
+		return drift;
+	}
+	periods++;
+
+	const double error = smooth - target;
+	drift = clamp(drift + DRIFT_KI * DRIFT_PERIOD * error);
+	return clamp(DRIFT_KP * error + drift);
+}
@@ -0,0 +1,44 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#pragma once
+
+// Playout clock drift between the sender and the sound card.
+// Update() is called once per 20 ms playback period with the audio
+// waiting to be heard: the receive queue plus what the device still
+// holds.  After the first two seconds that latency is the target, and
+// a PI loop on the smoothed latency returns the playout speed-up that
+// holds it there.  The integral part is the drift estimate.
+
+class CDriftEstimator
+{
+public:
+	CDriftEstimator() { Reset(); }
+	void Reset();
+	void Rebase();	// after an underrun, keep the drift but take a new target
+	double Update(double latency);	// latency in seconds, returns the speed-up, 1e-6 is 1 ppm
+	double Drift() const { return drift; }	// the estimate, in the same units
+	double Latency() const { return smooth; }
+	double Target() const { return target; }
+	bool Settled() const { return periods >= 0; }
+
+private:
+	double smooth;	// latency, averaged over a few seconds
+	double target;
+	double drift;
+	int periods;	// negative while settling
+};
@@ -0,0 +1,133 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#include "Latency.h"
+
+// the upper edges of the buckets in ms, the last one takes the rest
+static const double edges[LATENCY_BUCKETS-1] = { 0.5, 1, 2, 5, 10, 20, 50, 100, 150, 200, 300, 500, 1000 };
+
+static const char *names[int(ELatencyStage::count)] = {
+	"capture queue", "encode", "send queue", "pacing", "mic to network",
+	"decode queue", "decode", "playout queue", "device", "network to speaker"
+};
+
+void CLatencyHistogram::Reset()
+{
+	for (auto &b : buckets)
+		b = 0;
+	count = sum_us = max_us = 0;
+}
+
+void CLatencyHistogram::Add(double ms)
+{
+	if (ms < 0.0)
+		ms = 0.0;
+	int i = 0;
+	while (i < LATENCY_BUCKETS-1 && ms > edges[i])
+		i++;
+	buckets[i]++;
+	count++;
+	const uint64_t us = uint64_t(ms * 1000.0);
+	sum_us += us;
+	uint64_t max = max_us;
+	while (us > max && ! max_us.compare_exchange_weak(max, us))
+		;
+}
+
+void CLatencyHistogram::AddTo(CLatencyHistogram &to) const
+{
+	for (int i=0; i<LATENCY_BUCKETS; i++)
+		to.buckets[i] += buckets[i];
+	to.count += count;
+	to.sum_us += sum_us;
+	uint64_t max = to.max_us;
+	while (max_us > max && ! to.max_us.compare_exchange_weak(max, max_us))
+		;
+}
+
+double CLatencyHistogram::quantile(double q) const
+{
+	const uint64_t n = count;
+	uint64_t seen = 0;
+	for (int i=0; i<LATENCY_BUCKETS-1; i++) {
+		seen += buckets[i];
+		if (seen >= q * n)
+			return edges[i];
+	}
+	return max_us / 1000.0;
+}
+
+// e.g. "Audio latency decode: 1500 frames, mean 0.2 ms, p50 <1.0 ms,
+// p99 <1.0 ms, max 1.3 ms [<0.5 1200, <1 290, <2 10]"
+void CLatencyHistogram::Log(const char *name) const
+{
+	const uint64_t n = count;
+	if (0 == n)
+		return;
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1) << "Audio latency " << name << ": " << n << " frames, mean " << sum_us / 1000.0 / n << " ms, p50 <" << quantile(0.5) << " ms, p99 <" << quantile(0.99) << " ms, max " << max_us / 1000.0 << " ms [" << std::defaultfloat << std::setprecision(6);
+	const char *sep = "";
+	for (int i=0; i<LATENCY_BUCKETS; i++) {
+		if (0 == buckets[i])
+			continue;
+		if (i < LATENCY_BUCKETS-1)
+			line << sep << "<" << edges[i] << " " << buckets[i];
+		else
+			line << sep << ">" << edges[i-1] << " " << buckets[i];
+		sep = ", ";
+	}
+	line << "]";
+	std::cout << line.str() << std::endl;
+}
+
+void CLatencySet::Reset()
+{
+	for (auto &h : stages)
+		h.Reset();
+}
+
+void CLatencySet::AddTo(CLatencySet &to) const
+{
+	for (int i=0; i<int(ELatencyStage::count); i++)
+		stages[i].AddTo(to.stages[i]);
+}
+
+void CLatencySet::Log(bool transmit) const
+{
+	const int first = transmit ? 0 : int(ELatencyStage::decode_queue);
+	const int last = transmit ? int(ELatencyStage::decode_queue) : int(ELatencyStage::count);
+	for (int i=first; i<last; i++)
+		stages[i].Log(names[i]);
+}
+
+void CLatency::StreamEnd(const CLatencySet &set, bool transmit)
+{
+	set.Log(transmit);
+	set.AddTo(total);
+}
+
+void CLatency::LogTotals() const
+{
+	std::cout << "Audio latency since start:" << std::endl;
+	total.Log(true);
+	total.Log(false);
+}
@@ -0,0 +1,91 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Where the audio's time goes, mic to network and network to speaker.
+// Each stage keeps a histogram of its latency in ms.  A transmission, a
+// receive session and each received stream keep a set of their own, so
+// streams that overlap don't mix, and the session's is printed at its
+// end and added to the totals since start, which can be printed at any
+// time.  Add() doesn't lock.
+
+enum class ELatencyStage {
+	// transmit
+	capture_queue,	// waiting for the encoder
+	encode,
+	send_queue,	// encoded, waiting for the gateway
+	pacing,	// held for the 40 ms grid
+	mic_to_network,	// capture to the gateway, all of the above
+	// receive
+	decode_queue,	// from the gateway, waiting for a decoder
+	decode,
+	playout_queue,	// decoded, waiting for the mixer
+	device,	// mixed, in the output device
+	network_to_speaker,	// all of the receive stages
+	count
+};
+
+#define LATENCY_BUCKETS 14
+
+class CLatencyHistogram
+{
+public:
+	CLatencyHistogram() { Reset(); }
+	void Reset();
+	void Add(double ms);
+	void AddTo(CLatencyHistogram &total) const;
+	void Log(const char *name) const;
+
+private:
+	std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+	std::atomic<uint64_t> count, sum_us, max_us;
+	double quantile(double q) const;	// the bucket's upper edge, in ms
+};
+
+class CLatencySet
+{
+public:
+	void Add(ELatencyStage stage, double ms) { stages[int(stage)].Add(ms); }
+	// the frame's time since its last stage, if it has timestamps
+	template <class F> void Lap(ELatencyStage stage, F &frame)
+	{
+		if (frame.Stamped())
+			Add(stage, frame.Lap());
+	}
+	void Reset();
+	void AddTo(CLatencySet &to) const;
+	void Log(bool transmit) const;	// the stages of that side
+
+private:
+	CLatencyHistogram stages[int(ELatencyStage::count)];
+};
+
+// the totals since start
+class CLatency
+{
+public:
+	void StreamEnd(const CLatencySet &set, bool transmit);	// prints the set and adds it to the totals
+	void LogTotals() const;	// of what has ended
+
+private:
+	CLatencySet total;
+};
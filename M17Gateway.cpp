@@ -24,8 +24,10 @@
 #include <iomanip>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
 
 #include "M17Gateway.h"
+#include "Trace.h"
 
 CM17Gateway::CM17Gateway() : CBase()
 {
@@ -65,8 +67,10 @@ bool CM17Gateway::Init(const CFGDATA &cfgdata)
 		if (ipv6.Open(CSockAddress(AF_INET6, 0, "any"))) // use ephemeral port
 			return true;
 	}
+	qnvoice_file.assign(CFGDIR "/qnvoice");
+	if (voiceWatch.Open(CFGDIR))
+		std::cerr << "WARNING: voice prompts can't be asked for with " << qnvoice_file << std::endl;
 	keep_running = true;
-	currentStream.header.streamid = 0;
 	CConfigure config;
 	config.CopyFrom(cfgdata);
 	config.CopyTo(cfg);
@@ -84,36 +88,33 @@ void CM17Gateway::LinkCheck()
 	}
 }
 
-void CM17Gateway::StreamTimeout()
+void CM17Gateway::StreamTimeout(SStream &stream)
 {
 	// set the frame number
-	uint16_t fn = (currentStream.header.GetFrameNumber() + 1) % 0x8000u;
-	currentStream.header.SetFrameNumber(fn | 0x8000u);
+	uint16_t fn = (stream.header.GetFrameNumber() + 1) % 0x8000u;
+	stream.header.SetFrameNumber(fn | 0x8000u);
 	// fill in a silent codec2
-	switch (currentStream.header.GetFrameType() & 0x6u) {
+	switch (stream.header.GetFrameType() & 0x6u) {
 	case 0x4u:
 		{ //3200
 			uint8_t silent[] = { 0x01u, 0x00u, 0x09u, 0x43u, 0x9cu, 0xe4u, 0x21u, 0x08u };
-			memcpy(currentStream.header.payload,   silent, 8);
-			memcpy(currentStream.header.payload+8, silent, 8);
+			memcpy(stream.header.payload,   silent, 8);
+			memcpy(stream.header.payload+8, silent, 8);
 		}
 		break;
 	case 0x6u:
 		{ // 1600
 			uint8_t silent[] = { 0x01u, 0x00u, 0x04u, 0x00u, 0x25u, 0x75u, 0xddu, 0xf2u };
-			memcpy(currentStream.header.payload, silent, 8);
+			memcpy(stream.header.payload, silent, 8);
 		}
 		break;
 	default:
 		break;
 	}
 	// calculate the crc
-	currentStream.header.SetCRC(crc.CalcCRC(currentStream.header));
+	stream.header.SetCRC(crc.CalcCRC(stream.header));
 	// send the packet
-	M172AM.Write(currentStream.header.magic, sizeof(SM17Frame));
-	// close the stream;
-	currentStream.header.streamid = 0;
-	streamLock.unlock();
+	M172AM.Write(stream.header.magic, sizeof(SM17Frame));
 }
 
 void CM17Gateway::PlayVoiceFile()
@@ -166,12 +167,17 @@ void CM17Gateway::Process()
 	const auto ip4fd = ipv4.GetSocket();
 	const auto ip6fd = ipv6.GetSocket();
 	const auto amfd = AM2M17.GetFD();
+	const auto voicefd = voiceWatch.GetFD();
 	if ((EInternetType::ipv6only != cfg.eNetType) && (ip4fd > max_nfds))
 		max_nfds = ip4fd;
 	if ((EInternetType::ipv4only != cfg.eNetType) && (ip6fd > max_nfds))
 		max_nfds = ip6fd;
 	if (amfd > max_nfds)
 		max_nfds = amfd;
+	if (voicefd > max_nfds)
+		max_nfds = voicefd;
+	TRACE_THREAD("gateway");
+	PlayVoiceFile(); // one that was asked for before we were watching
 	while (keep_running)
 	{
 		if (ELinkState::linked == mlink.state)
@@ -187,18 +193,28 @@ void CM17Gateway::Process()
 			}
 		}
 
-		if (currentStream.header.streamid && currentStream.lastPacketTime.time() >= 2.0)
+		for (auto it=streams.begin(); streams.end()!=it; )
 		{
-			StreamTimeout(); // current stream has timed out
+			if (it->second.lastPacketTime.time() >= 2.0)
+			{
+				StreamTimeout(it->second); // this stream has timed out
+				it = streams.erase(it);
+				if (streams.empty())
+					streamLock.unlock();
+			}
+			else
+			{
+				it++;
+			}
 		}
-		PlayVoiceFile(); // play if there is any msg to play
-
 		FD_ZERO(&fdset);
 		if (EInternetType::ipv6only != cfg.eNetType)
 			FD_SET(ip4fd, &fdset);
 		if (EInternetType::ipv4only != cfg.eNetType)
 			FD_SET(ip6fd, &fdset);
 		FD_SET(amfd, &fdset);
+		if (voicefd >= 0)
+			FD_SET(voicefd, &fdset);
 		tv.tv_sec = 0;
 		tv.tv_usec = 40000;	// wait up to 40 ms for something to happen
 		auto rval = select(max_nfds + 1, &fdset, 0, 0, &tv);
@@ -336,6 +352,13 @@ void CM17Gateway::Process()
 			}
 			FD_CLR(amfd, &fdset);
 		}
+
+		if (keep_running && (voicefd >= 0) && FD_ISSET(voicefd, &fdset))
+		{
+			if (voiceWatch.Changed("qnvoice"))
+				PlayVoiceFile(); // play if there is any msg to play
+			FD_CLR(voicefd, &fdset);
+		}
 	}
 	AM2M17.Close();
 	ipv4.Close();
@@ -377,51 +400,44 @@ void CM17Gateway::SendLinkRequest(const CCallsign &ref)
 
 bool CM17Gateway::ProcessFrame(const uint8_t *buf)
 {
+	TRACE_SPAN("CM17Gateway::ProcessFrame");
 	SM17Frame frame;
 	memcpy(frame.magic, buf, sizeof(SM17Frame));
-	if (currentStream.header.streamid)
+	auto it = streams.find(frame.streamid);
+	if (streams.end() != it)
 	{
-		if (currentStream.header.streamid == frame.streamid)
+		M172AM.Write(frame.magic, sizeof(SM17Frame));
+		uint16_t fn = frame.GetFrameNumber();
+		if (fn & 0x8000u)
 		{
-			M172AM.Write(frame.magic, sizeof(SM17Frame));
-			currentStream.header.SetFrameNumber(frame.GetFrameNumber());
-			uint16_t fn = frame.GetFrameNumber();
-			if (fn & 0x8000u)
-			{
-				SendLog("Close stream id=0x%04x, duration=%.2f sec\n", frame.GetStreamID(), 0.04f * (0x7fffu & fn));
-				currentStream.header.SetFrameNumber(0); // close the stream
-				currentStream.header.streamid = 0;
+			SendLog("Close stream id=0x%04x, duration=%.2f sec\n", frame.GetStreamID(), 0.04f * (0x7fffu & fn));
+			streams.erase(it); // close the stream
+			if (streams.empty())
 				streamLock.unlock();
-			}
-			else
-			{
-				currentStream.lastPacketTime.start();
-			}
 		}
 		else
 		{
-			return false;
+			it->second.header.SetFrameNumber(fn);
+			it->second.lastPacketTime.start();
 		}
 	}
 	else
 	{
-		// here comes a first packet, so try to lock it
-		if (streamLock.try_lock())
-		{
-			// then init the currentStream
-			auto check = crc.CalcCRC(frame);
-			if (frame.GetCRC() != check)
-				std::cout << "Header Packet crc=0x" << std::hex << frame.GetCRC() << " calculate=0x" << std::hex << check << std::endl;
-			memcpy(currentStream.header.magic, frame.magic, sizeof(SM17Frame));
-			M172AM.Write(frame.magic, sizeof(SM17Frame));
-			const CCallsign call(frame.lich.addr_src);
-			SendLog("Open stream id=0x%04x from %s at %s\n", frame.GetStreamID(), call.GetCS().c_str(), from17k.GetAddress());
-			currentStream.lastPacketTime.start();
-		}
-		else
-		{
+		// here comes a first packet, the first stream has to take the lock from PTT
+		if (streams.size() >= (size_t)std::max(1, cfg.iRxStreams))
 			return false;
-		}
+		if (streams.empty() && ! streamLock.try_lock())
+			return false;
+		// then init the stream
+		auto check = crc.CalcCRC(frame);
+		if (frame.GetCRC() != check)
+			std::cout << "Header Packet crc=0x" << std::hex << frame.GetCRC() << " calculate=0x" << std::hex << check << std::endl;
+		SStream &stream = streams[frame.streamid];
+		memcpy(stream.header.magic, frame.magic, sizeof(SM17Frame));
+		M172AM.Write(frame.magic, sizeof(SM17Frame));
+		const CCallsign call(frame.lich.addr_src);
+		SendLog("Open stream id=0x%04x from %s at %s, %u open\n", frame.GetStreamID(), call.GetCS().c_str(), from17k.GetAddress(), unsigned(streams.size()));
+		stream.lastPacketTime.start();
 	}
 	return true;
 }
@@ -21,8 +21,10 @@
 #include <atomic>
 #include <string>
 #include <mutex>
+#include <map>
 
 #include "UnixDgramSocket.h"
+#include "DirWatch.h"
 #include "SockAddress.h"
 #include "Configure.h"
 #include "UDPSocket.h"
@@ -72,15 +74,16 @@ private:
 	CUDPSocket ipv4, ipv6;
 	SM17Link mlink;
 	CTimer linkingTime;
-	SStream currentStream;
-	std::mutex streamLock;
-	std::string qnvoice_file;
+	std::map<uint16_t, SStream> streams;	// the open ones, up to cfg.iRxStreams
+	std::mutex streamLock;	// held by PTT, or while any stream is open
+	std::string qnvoice_file;	// a prompt's name written here plays it
+	CDirWatch voiceWatch;	// the directory of qnvoice_file
 	CSockAddress from17k, destination;
 
 	void LinkCheck();
 	void Write(const void *buf, const size_t size, const CSockAddress &addr) const;
 	void PlayAudioMessage(const char *msg);
-	void StreamTimeout();
+	void StreamTimeout(SStream &stream);
 	void PlayVoiceFile();
 	void PlayAudioNotifyMessage(const char *msg);
 	void Send(const void *buf, size_t size, const CSockAddress &addr) const;
@@ -28,6 +28,7 @@
 #include <thread>
 #include <chrono>
 #include <cmath>
+#include <csignal>
 
 #include <FL/filename.H>
 
@@ -49,19 +50,65 @@ static const char *updatestr = _("Delete");
 
 static CM17RouteMap routeMap;
 
+// kill -USR1 prints the audio latency statistics
+static volatile sig_atomic_t latencyRequest = 0;
+
+static void LatencySignal(int)
+{
+	latencyRequest = 1;
+}
+
+#ifdef USE_TRACE
+// kill -USR2 starts tracing, and the next one writes the trace
+static volatile sig_atomic_t traceRequest = 0;
+
+static void TraceSignal(int)
+{
+	traceRequest = 1;
+}
+#endif
+
 static void MyIdleProcess(void *p)
 {
 	CMainWindow *pMainWindow = (CMainWindow *)p;
 	pMainWindow->UpdateGUI();
+	if (latencyRequest) {
+		latencyRequest = 0;
+		pMainWindow->AudioManager.LogLatency();
+	}
+#ifdef USE_TRACE
+	if (traceRequest) {
+		traceRequest = 0;
+		if (CTrace::Enabled()) {
+			CTrace::Enable(false);
+			CTrace::Dump(std::string(CFGDIR) + "/trace.json");
+		} else {
+			CTrace::Enable(true);
+			std::cout << "Tracing started, kill -USR2 again to write it" << std::endl;
+		}
+	}
+#endif
 
 	Fl::repeat_timeout(1.0, MyIdleProcess, pMainWindow);
 }
 
+#define STALL_CHECK 0.1	// seconds
+
+static void StallCheckProcess(void *p)
+{
+	CMainWindow *pMainWindow = (CMainWindow *)p;
+	pMainWindow->StallCheck();
+
+	// from now, as stallDue is, repeat_timeout() would keep the old grid
+	Fl::add_timeout(STALL_CHECK, StallCheckProcess, pMainWindow);
+}
+
 CMainWindow::CMainWindow() :
 #ifndef NO_DHT
 	exportNodeFilename("/exNodes.bin"),
 #endif
 	pWin(nullptr),
+	stallWorst(0.0),
 	bDestCS(false),
 	bDestIP(false),
 	bDestPort(false),
@@ -104,6 +151,12 @@ CMainWindow::~CMainWindow()
 		keep_running = false;
 		futReadThread.get();
 	}
+	if (futAudioTasks.valid())
+	{
+		audioTasks.Push(std::function<void()>());
+		futAudioTasks.get();
+	}
+	std::cout << "Longest GUI event loop stall was " << stallWorst << " ms" << std::endl;
 	StopM17();
 	if (pWin)
 		delete pWin;
@@ -180,6 +233,7 @@ bool CMainWindow::Init()
 
 	keep_running = true;
 	futReadThread = std::async(std::launch::async, &CMainWindow::ReadThread, this);
+	futAudioTasks = std::async(std::launch::async, &CMainWindow::AudioTasks, this);
 
 	pIcon = new Fl_RGB_Image(icon_image.pixel_data, icon_image.width, icon_image.height, icon_image.bytes_per_pixel);
 	pWin = new Fl_Double_Window(900, 600, "YaMVoice");
@@ -304,11 +358,13 @@ bool CMainWindow::Init()
 	}
 
 	routeMap.ReadAll();
-	Receive(false);
+	ReceiveState(false);
 	SetState();
 
 	// idle processing
 	Fl::add_timeout(1.0, MyIdleProcess, this);
+	stallDue = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(STALL_CHECK));
+	Fl::add_timeout(STALL_CHECK, StallCheckProcess, this);
 
 #ifndef NO_DHT
 	// start the dht instance
@@ -378,8 +434,12 @@ void CMainWindow::QuitCB(Fl_Widget *, void *This)
 
 void CMainWindow::Quit()
 {
-	AudioManager.KeyOff();
-	StopM17();
+	// the window goes now, the destructor waits for the last over to end
+	audioTasks.Push([this]() {
+		AudioManager.KeyOff();
+		AudioManager.StopCapture();
+		StopM17();
+	});
 
 	if (pWin)
 		pWin->hide();
@@ -411,6 +471,14 @@ void CMainWindow::NewSettings(CFGDATA *newdata)
 		if (newdata->sM17SourceCallsign.compare(cfgdata.sM17SourceCallsign) || newdata->eNetType!=cfgdata.eNetType) {
 			StopM17();
 		}
+		// cfg is already the new one, the capture starts again from it with
+		// the new device or pre-roll, after any over that is still ending
+		if (newdata->sAudioIn.compare(cfgdata.sAudioIn) || newdata->iPreRoll != cfgdata.iPreRoll) {
+			audioTasks.Push([this]() {
+				AudioManager.StopCapture();
+				AudioManager.StartCapture();
+			});
+		}
 		cfg.CopyTo(cfgdata);
 	}
 	SetState();
@@ -502,16 +570,56 @@ void CMainWindow::EchoButton()
 	if (onchar) {
 		bTransOK = false;
 		// record the mic to a queue
-		AudioManager.RecordMicThread(E_PTT_Type::echo, "ECHOTEST");
+		audioTasks.Push([this]() { AudioManager.RecordMicThread(E_PTT_Type::echo, "ECHOTEST"); });
 	} else {
-		AudioSummary(_("Echo"));
-		// play back the queue
-		AudioManager.PlayEchoDataThread();
-		bTransOK = true;
+		pEchoTestButton->deactivate();	// until the playback is done
+		audioTasks.Push([this]() {
+			AudioSummary(_("Echo"));
+			// play back the queue
+			AudioManager.PlayEchoDataThread();
+			Fl::awake(&CMainWindow::EchoDoneCB, this);
+		});
 	}
 }
 
+void CMainWindow::EchoDoneCB(void *This)
+{
+	((CMainWindow *)This)->EchoDone();
+}
+
+void CMainWindow::EchoDone()
+{
+	bTransOK = true;
+	pEchoTestButton->activate();
+}
+
+// Runs the audio tasks one after the other, so a key off can't overtake
+// the PTT it ends.  The FLTK thread only queues them, and hears back
+// through Fl::awake().
+void CMainWindow::AudioTasks()
+{
+	TRACE_THREAD("audio tasks");
+	for (auto task=audioTasks.WaitPop(); task; task=audioTasks.WaitPop())
+		task();
+}
+
+// called from the audio threads, the widgets change on the FLTK thread
 void CMainWindow::Receive(bool is_rx)
+{
+	Fl::awake(is_rx ? &CMainWindow::ReceiveOnCB : &CMainWindow::ReceiveOffCB, this);
+}
+
+void CMainWindow::ReceiveOnCB(void *This)
+{
+	((CMainWindow *)This)->ReceiveState(true);
+}
+
+void CMainWindow::ReceiveOffCB(void *This)
+{
+	((CMainWindow *)This)->ReceiveState(false);
+}
+
+void CMainWindow::ReceiveState(bool is_rx)
 {
 	bTransOK = ! is_rx;
 	TransmitterButtonControl();
@@ -551,7 +659,7 @@ void CMainWindow::PTTButton()
 		{
 			std::string cs;
 			SetDestinationAddress(cs);
-			AudioManager.RecordMicThread(E_PTT_Type::m17, cs);
+			audioTasks.Push([this, cs]() { AudioManager.RecordMicThread(E_PTT_Type::m17, cs); });
 		}
 		else
 		{
@@ -560,9 +668,43 @@ void CMainWindow::PTTButton()
 	}
 	else
 	{
-		AudioManager.KeyOff();
-		AudioSummary(pttstr);
-		gateM17.ReleaseLock();
+		// the gateway stays locked until the over is done
+		bTransOK = false;
+		TransmitterButtonControl();
+		pEchoTestButton->deactivate();
+		audioTasks.Push([this]() {
+			AudioManager.KeyOff();
+			AudioSummary(pttstr);
+			Fl::awake(&CMainWindow::KeyOffDoneCB, this);
+		});
+	}
+}
+
+void CMainWindow::KeyOffDoneCB(void *This)
+{
+	((CMainWindow *)This)->KeyOffDone();
+}
+
+void CMainWindow::KeyOffDone()
+{
+	gateM17.ReleaseLock();
+	bTransOK = true;
+	TransmitterButtonControl();
+	pEchoTestButton->activate();
+}
+
+// A timer due every STALL_CHECK seconds, how late it runs is how long
+// the event loop was held up.
+void CMainWindow::StallCheck()
+{
+	const auto now = std::chrono::steady_clock::now();
+	const double late = std::chrono::duration<double, std::milli>(now - stallDue).count();
+	stallDue = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(STALL_CHECK));
+	if (late > stallWorst)
+	{
+		stallWorst = late;
+		if (late >= 100.0)
+			std::cout << "GUI event loop stalled for " << late << " ms" << std::endl;
 	}
 }
 
@@ -570,7 +712,8 @@ void CMainWindow::QuickKeyButton()
 {
 	std::string cs;
 	SetDestinationAddress(cs);
-	AudioManager.QuickKey(cs, cfgdata.sM17SourceCallsign);
+	const std::string source(cfgdata.sM17SourceCallsign);
+	audioTasks.Push([this, cs, source]() { AudioManager.QuickKey(cs, source); });	// it takes 160 ms
 }
 
 void CMainWindow::QuickKeyButttonCB(Fl_Widget *, void *This)
@@ -580,6 +723,7 @@ void CMainWindow::QuickKeyButttonCB(Fl_Widget *, void *This)
 
 void CMainWindow::ReadThread()
 {
+	TRACE_THREAD("reader");
 	while (keep_running)
 	{
 		auto gatefd = M172AM.GetFD();
@@ -608,6 +752,11 @@ void CMainWindow::ReadThread()
 				M172AM.Read(frame.magic, sizeof(SM17Frame));
 				if (0 == memcmp(frame.magic, "M17 ", 4))
 					AudioManager.M17_2AudioMgr(frame);
+				else if (0 == memcmp(frame.magic, "PLAY", 4))
+				{
+					const char *name = (const char *)frame.magic + 4;
+					AudioManager.PlayPrompt(std::string(name, strnlen(name, sizeof(SM17Frame) - 4)));
+				}
 			}
 			if (FD_ISSET(logfd, &fdset))
 			{
@@ -1118,6 +1267,11 @@ int main (int argc, char **argv)
 	CMainWindow MainWindow;
 	if (MainWindow.Init())
 		return 1;
+	signal(SIGUSR1, LatencySignal);
+#ifdef USE_TRACE
+	TRACE_THREAD("gui");
+	signal(SIGUSR2, TraceSignal);
+#endif
 
 	Fl::lock();	// "start" the FLTK lock mechanism
 
@@ -22,6 +22,8 @@
 #include <future>
 #include <atomic>
 #include <mutex>
+#include <chrono>
+#include <functional>
 #ifndef NO_DHT
 #include <opendht.h>
 #endif
@@ -49,6 +51,7 @@ public:
 	void Receive(bool is_rx);
 	void NewSettings(CFGDATA *newdata);
 	void UpdateGUI();
+	void StallCheck();
 
 	// helpers
 	bool ToUpper(std::string &s);
@@ -85,6 +88,15 @@ private:
 	// state data
 	CFGDATA cfgdata;
 	std::mutex logmux;
+	// how late the FLTK event loop runs a timer, the longest since start
+	std::chrono::steady_clock::time_point stallDue;
+	double stallWorst;
+
+	// audio operations that wait, run in order off the FLTK thread,
+	// an empty task ends the thread
+	CTQueue<std::function<void()>> audioTasks;
+	std::future<void> futAudioTasks;
+	void AudioTasks();
 
 	// helpers
 	void BuildDestMenuButton();
@@ -107,6 +119,7 @@ private:
 	void Get(const std::string &cs);
 #endif
 	void ActivateModules(const std::string &modules = "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
+	void ReceiveState(bool is_rx);
 
 	// Actual Callbacks
 	void Quit();
@@ -123,6 +136,8 @@ private:
 	void LinkButton();
 	void UnlinkButton();
 	void DashboardButton();
+	void KeyOffDone();
+	void EchoDone();
 	// Static wrapper for callbacks
 	static void QuitCB(Fl_Widget *p, void *v);
 	static void ShowSettingsDialogCB(Fl_Widget *p, void *v);
@@ -138,6 +153,11 @@ private:
 	static void LinkButtonCB(Fl_Widget *p, void *v);
 	static void UnlinkButtonCB(Fl_Widget *p, void *v);
 	static void DashboardButtonCB(Fl_Widget *p, void *v);
+	// Fl::awake() handlers, from the audio threads
+	static void KeyOffDoneCB(void *v);
+	static void EchoDoneCB(void *v);
+	static void ReceiveOnCB(void *v);
+	static void ReceiveOffCB(void *v);
 
 	bool bDestCS, bDestIP, bDestPort, bTransOK;
 	std::atomic<bool> keep_running;
@@ -0,0 +1,84 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <errno.h>
+
+#include <iostream>
+#include <atomic>
+
+#include "RealTime.h"
+
+#define RT_STACK_PREFAULT (256 * 1024)	// more than the codec threads use
+
+static std::atomic<bool> locked(false), warned_lock(false), warned_priority(false), warned_cpu(false);
+
+// all return true on error, and only the first failure of each kind is reported
+bool CRealTime::LockMemory()
+{
+	if (locked)
+		return false;
+	if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+		if (! warned_lock.exchange(true))
+			std::cerr << "WARNING: can't lock memory, " << strerror(errno) << ", audio may be paged out" << std::endl;
+		return true;
+	}
+	locked = true;
+	return false;
+}
+
+bool CRealTime::SetPriority(int priority)
+{
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (rc) {
+		if (! warned_priority.exchange(true))
+			std::cerr << "WARNING: can't use SCHED_FIFO priority " << priority << ", " << strerror(rc) << ", audio threads run at normal priority" << std::endl;
+		return true;
+	}
+	return false;
+}
+
+bool CRealTime::SetCPU(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc && ! warned_cpu.exchange(true))
+		std::cerr << "WARNING: can't run an audio thread on CPU " << cpu << ", " << strerror(rc) << std::endl;
+	return rc != 0;
+#else
+	if (! warned_cpu.exchange(true))
+		std::cerr << "WARNING: CPU affinity is not supported here, CPU " << cpu << " ignored" << std::endl;
+	return true;
+#endif
+}
+
+void CRealTime::PrefaultStack()
+{
+	volatile unsigned char stack[RT_STACK_PREFAULT];
+	for (int i=0; i<RT_STACK_PREFAULT; i+=4096)
+		stack[i] = 0;
+	(void)stack[0];
+}
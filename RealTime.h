@@ -0,0 +1,31 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+#pragma once
+
+// Real-time scheduling for the audio threads.  Everything here degrades
+// to a warning, printed once, when the process is not allowed to do it:
+// SCHED_FIFO needs RLIMIT_RTPRIO (or root), mlockall() RLIMIT_MEMLOCK.
+
+class CRealTime
+{
+public:
+	static bool LockMemory();	// mlockall(), once per process
+	static bool SetPriority(int priority);	// SCHED_FIFO for the calling thread
+	static bool SetCPU(int cpu);	// pin the calling thread, Linux only
+	static void PrefaultStack();	// touch the stack now, not during the first period
+};
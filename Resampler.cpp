@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <cmath>
+#include <numeric>
 
 #include "Resampler.h"
 #include "fastest_coeffs.h"
@@ -19,6 +20,30 @@
 #define	FP_ONE					((double)(((int) 1) << SHIFT_BITS))
 #define	INV_FP_ONE				(1.0 / FP_ONE)
 
+#define POLY_MAX				1000	// largest L or M of a polyphase ratio
+#define POLY_BLOCK				8		// taps per pass of the inner product
+#define POLY_PHASES				256		// fewest bank rows, fine enough for a trim
+
+typedef float v4sf __attribute__ ((vector_size (16)));
+
+// taps is a multiple of POLY_BLOCK, loads are unaligned
+static inline float poly_dot(const float *a, const float *b, int taps)
+{
+	v4sf s0 = { 0.0f, 0.0f, 0.0f, 0.0f }, s1 = s0;
+	for (int i=0; i<taps; i+=POLY_BLOCK)
+	{
+		v4sf a0, a1, b0, b1;
+		memcpy(&a0, a + i,     sizeof(v4sf));
+		memcpy(&a1, a + i + 4, sizeof(v4sf));
+		memcpy(&b0, b + i,     sizeof(v4sf));
+		memcpy(&b1, b + i + 4, sizeof(v4sf));
+		s0 += a0 * b0;
+		s1 += a1 * b1;
+	}
+	s0 += s1;
+	return (s0[0] + s0[1]) + (s0[2] + s0[3]);
+}
+
 int CResampler::double_to_fp(double x)
 {
 	return lrint(x * FP_ONE);
@@ -58,6 +83,8 @@ void CResampler::sinc_set_converter()
 
 	filter.buffer.resize(filter.b_len + 1, 0.0f);
 
+	trim = 0.0;
+	poly.Init();
 	Reset();
 
 	int count = filter.coeff_half_len;
@@ -75,9 +102,136 @@ void CResampler::Reset()
 	filter.b_real_end = -1;
 
 	filter.input_index = 0.0;
+	last_position = 0.0;
 
 	for (auto it=filter.buffer.begin(); it!=filter.buffer.end(); it++)
 		*it = 0;
+
+	// the first output is centred on the first input sample
+	poly.phase = 0;
+	poly.base = 0;
+	poly.real_end = -1;
+	poly.slip = 0.0;
+	poly.buffer.assign(poly.half ? poly.half - 1 : 0, 0.0f);
+}
+
+// the filter table at x table steps from the centre, linearly interpolated
+double CResampler::sinc_coeff(double x)
+{
+	if (x >= filter.coeff_half_len)
+		return 0.0;
+	int indx = int(x);
+	double fraction = x - indx;
+	return filter.coeffs[indx] + fraction * (filter.coeffs[indx + 1] - filter.coeffs[indx]);
+}
+
+// Build the bank for ratio if it is L/M with small L and M, the same
+// filter the sinc converter would use.  Returns false and leaves the
+// sinc converter in charge otherwise.  The bank always has at least
+// POLY_PHASES rows, so a later trim never has to rebuild it on the
+// playback thread.
+bool CResampler::poly_set_ratio(double ratio)
+{
+	poly.Init();
+	poly.bank.clear();
+
+	int L = 0, M;
+	for (M=1; M<=POLY_MAX; M++)
+	{
+		L = lrint(ratio * M);
+		if (L > 0 && L <= POLY_MAX && fabs(L - ratio * M) < 1e-9 * M)
+			break;
+	}
+	if (M > POLY_MAX)
+	{
+		Reset();
+		return false;
+	}
+
+	const int k = (L < POLY_PHASES) ? (POLY_PHASES + L - 1) / L : 1;
+	poly_build(L * k, M * k, ratio);
+	Reset();
+	return true;
+}
+
+// L/M need not be in lowest terms, a finer bank gives the same outputs
+// and lets a trim move the output position by a smaller step
+void CResampler::poly_build(int L, int M, double ratio)
+{
+	double scale = (ratio < 1.0) ? ratio : 1.0;
+	double step = filter.index_inc * scale;	// table steps per input sample
+	poly.L = L;
+	poly.M = M;
+	poly.ratio = ratio;
+	poly.half = int(ceil(filter.coeff_half_len / step));
+	poly.taps = (2 * poly.half + 1 + POLY_BLOCK - 1) / POLY_BLOCK * POLY_BLOCK;
+	poly.bank.resize(size_t(L + 1) * poly.taps);	// row L is row 0 one input later, for the trim
+	for (int p=0; p<=L; p++)
+	{
+		double frac = double(p) / L;
+		for (int m=0; m<poly.taps; m++)
+			poly.bank[size_t(p) * poly.taps + m] = float(scale * sinc_coeff(fabs(m - poly.half + 1 - frac) * step));
+	}
+}
+
+// A small trim, for clock drift, keeps the bank: the output position
+// creeps away from the rows, and each output is interpolated between the
+// two rows either side of it.  Rows are at most 1/POLY_PHASES of an input
+// sample apart, which keeps that interpolation as clean as the filter.
+// The sinc converter just runs at the trimmed ratio.  Nothing here
+// allocates, it is called from the playback thread.
+void CResampler::SetTrim(double new_trim)
+{
+	trim = new_trim;
+	if (0 == poly.L)
+		return;
+	poly.slip_step = poly.M / (1.0 + trim) - poly.M;
+}
+
+// All of the input is always taken, whatever does not fit in the output
+// waits in the history for the next call, so chunk sizes are free.
+bool CResampler::poly_process(SDATA &data)
+{
+	poly.buffer.insert(poly.buffer.end(), data.data_in, data.data_in + data.input_frames);
+	if (data.end_of_input && poly.real_end < 0)
+	{
+		poly.real_end = poly.buffer.size();
+		poly.buffer.resize(poly.buffer.size() + poly.taps, 0.0f);
+	}
+
+	const long size = poly.buffer.size();
+	const float *in = poly.buffer.data();
+	long out_gen = 0;
+	while (out_gen < data.output_frames && poly.base + poly.taps <= size)
+	{
+		if (poly.real_end >= 0 && poly.base + poly.half - 1 >= poly.real_end)
+			break;
+		const float *row = poly.bank.data() + size_t(poly.phase) * poly.taps;
+		float y = poly_dot(row, in + poly.base, poly.taps);
+		if (poly.slip_step != 0.0)
+		{
+			// the output is slip of a row past phase
+			y += float(poly.slip) * (poly_dot(row + poly.taps, in + poly.base, poly.taps) - y);
+			poly.slip += poly.slip_step;
+			int extra = int(floor(poly.slip));
+			poly.slip -= extra;
+			poly.phase += extra;
+		}
+		data.data_out[out_gen++] = y;
+		poly.phase += poly.M;
+		poly.base += poly.phase / poly.L;
+		poly.phase %= poly.L;
+	}
+
+	// drop the history no later output can reach
+	poly.buffer.erase(poly.buffer.begin(), poly.buffer.begin() + poly.base);
+	if (poly.real_end >= 0)
+		poly.real_end -= poly.base;
+	poly.base = 0;
+
+	data.input_frames_used = data.input_frames;
+	data.output_frames_gen = out_gen;
+	return false;
 }
 
 double CResampler::calc_output_single(int increment, int start_filter_index)
@@ -132,6 +286,9 @@ double CResampler::calc_output_single(int increment, int start_filter_index)
 
 bool CResampler::Process(SDATA &data)
 {
+	if (poly.L && data.ratio == poly.ratio)
+		return poly_process(data);
+
 	/* If there is not a problem, this will be optimised out. */
 	if (sizeof(filter.buffer[0]) != sizeof(data.data_in[0])) {
 		std::cerr << "Internal error. Input data / internal buffer size difference. Please report this." << std::endl;
@@ -142,10 +299,12 @@ bool CResampler::Process(SDATA &data)
 	filter.out_count = data.output_frames;
 	filter.in_used = filter.out_gen = 0;
 
+	const double ratio = data.ratio * (1.0 + trim);
+
 	/* Check the sample rate ratio wrt the buffer len. */
 	double count = (filter.coeff_half_len + 2.0) / filter.index_inc;
-	if (data.ratio < 1.0)
-		count /= data.ratio;
+	if (ratio < 1.0)
+		count /= ratio;
 
 	/* Maximum coefficientson either side of center point. */
 	int half_filter_chan_len = lrint(count) + 1;
@@ -157,7 +316,7 @@ bool CResampler::Process(SDATA &data)
 	filter.b_current = (filter.b_current + lrint(input_index - rem)) % filter.b_len;
 	input_index = rem;
 
-	double terminate = 1.0 / data.ratio + 1e-20;
+	double terminate = 1.0 / ratio + 1e-20;
 
 	/* Main processing loop. */
 	while (filter.out_gen < filter.out_count)
@@ -182,7 +341,7 @@ bool CResampler::Process(SDATA &data)
 				break;
 		};
 
-		float_increment = filter.index_inc * (data.ratio < 1.0 ? data.ratio : 1.0);
+		float_increment = filter.index_inc * (ratio < 1.0 ? ratio : 1.0);
 		int increment = double_to_fp(float_increment);
 
 		int start_filter_index = double_to_fp(input_index * float_increment);
@@ -191,7 +350,7 @@ bool CResampler::Process(SDATA &data)
 		filter.out_gen ++;
 
 		/* Figure out the next index. */
-		input_index += 1.0 / data.ratio;
+		input_index += 1.0 / ratio;
 		rem = fmod_one(input_index);
 
 		filter.b_current = (filter.b_current + lrint(input_index - rem)) % filter.b_len;
@@ -285,16 +444,39 @@ bool CResampler::prepare_data(SDATA &data, int half_filter_chan_len)
 
 	return false;
 }
-bool CResampler::SetRatio(SDATA &data, double new_ratio)
+
+// a fixed rational ratio such as 44100/8000 or 6 uses the polyphase bank,
+// anything else the sinc converter
+bool CResampler::SetRatio(SDATA &data, double new_ratio, bool allow_polyphase)
 {
 	if (new_ratio > 40.0 || new_ratio < 1.0/40.0) {
 		std::cerr << "Resample ratio of " << new_ratio << " is out of range" << std::endl;
 		return true;
 	}
 	data.ratio = new_ratio;
+	trim = 0.0;
+	if (allow_polyphase)
+		poly_set_ratio(new_ratio);
+	else
+	{
+		poly.Init();
+		poly.bank.clear();
+		Reset();
+	}
 	return false;
 }
 
+// which engine SetRatio() picked, for the log
+std::string CResampler::Describe() const
+{
+	if (poly.L)
+	{
+		const int g = std::gcd(poly.L, poly.M);	// the bank is built finer than L/M
+		return "polyphase " + std::to_string(poly.L / g) + "/" + std::to_string(poly.M / g) + ", " + std::to_string(poly.taps) + " taps";
+	}
+	return "sinc";
+}
+
 void CResampler::Short2Float(const short *in, float *out, int len)
 {
 	while (len)
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 using SDATA = struct data_tag
@@ -58,21 +59,53 @@ using SINC_FILTER = struct sinc_filter_tab
 	}
 };
 
+// polyphase filter bank for a fixed rational ratio L/M: output sample n
+// sits at input position n*M/L, so its taps are bank row (n*M)%L and
+// no coefficient has to be interpolated per sample
+using POLY_FILTER = struct poly_filter_tag
+{
+	int		L, M;			// ratio is L/M, both 0 when the sinc converter is used
+	int		taps;			// per phase, a multiple of POLY_BLOCK
+	int		half;			// input samples left of the output position
+	int		phase;			// bank row of the next output
+	long	base;			// buffer index of the first tap of the next output
+	long	real_end;		// buffer index just past the last input after end_of_input, else -1
+
+	double	ratio;
+	double	slip_step;		// extra rows per output for the trim, 0 when untrimmed
+	double	slip;			// fraction of a row carried to the next output
+
+	std::vector<float> bank;	// L rows of taps
+	std::vector<float> buffer;	// input history, starts at pos - half + 1
+
+	void Init()
+	{
+		L = M = taps = half = phase = 0;
+		base = 0;
+		real_end = -1;
+		ratio = slip_step = slip = 0.0;
+	}
+};
+
 class CResampler
 {
 public:
 	CResampler() { sinc_set_converter(); }
 	bool Process(SDATA &data);
 	void Reset();
-	bool SetRatio(SDATA &data, double new_ratio);
+	bool SetRatio(SDATA &data, double new_ratio, bool allow_polyphase = true);
+	void SetTrim(double new_trim);	// the ratio in use is data.ratio * (1 + new_trim)
+	std::string Describe() const;
 
 	void Short2Float(const short *in, float *out, int len);
 	void Float2Short(const float *in, short *out, int len);
 
 private:
 	SINC_FILTER filter;
+	POLY_FILTER poly;
 	bool reset;
 	float last_value;
+	double trim;
 
 	double	last_position;
 	int double_to_fp(double x);
@@ -84,4 +117,8 @@ private:
 	double calc_output_single(int increment, int start_filter_index);
 	bool prepare_data(SDATA &data, int half_filter_chan_len);
 	double fmod_one(const double x);
+	double sinc_coeff(double x);
+	bool poly_set_ratio(double ratio);
+	void poly_build(int L, int M, double ratio);
+	bool poly_process(SDATA &data);
 };
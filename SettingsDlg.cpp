@@ -107,6 +107,23 @@ void CSettingsDlg::SaveWidgetStates(CFGDATA &d)
 			d.sAudioOut.assign(itout->second.first);
 		}
 	}
+	d.eEncoderEffort = data.eEncoderEffort;
+	d.bSilenceDetect = data.bSilenceDetect;
+	d.bEncoderPipeline = data.bEncoderPipeline;
+	d.bAudioMmap = data.bAudioMmap;
+	d.bAudioFast = data.bAudioFast;
+	d.bRealTime = data.bRealTime;
+	d.iRealTimePriority = data.iRealTimePriority;
+	d.iCaptureCPU = data.iCaptureCPU;
+	d.iEncodeCPU = data.iEncodeCPU;
+	d.iDecodeCPU = data.iDecodeCPU;
+	d.iPlaybackCPU = data.iPlaybackCPU;
+	d.iPreRoll = data.iPreRoll;
+	d.iRxStreams = data.iRxStreams;
+	d.iTxQueue = data.iTxQueue;
+	d.iRxQueue = data.iRxQueue;
+	d.eTxQueuePolicy = data.eTxQueuePolicy;
+	d.eRxQueuePolicy = data.eRxQueuePolicy;
 #ifndef NO_DHT
 	d.sBootstrap.assign(pBootstrapInput->value());
 #endif
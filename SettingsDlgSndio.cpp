@@ -21,6 +21,7 @@
 #include <sndio.h>
 
 #include "SettingsDlg.h"
+#include "AudioManager.h"
 
 class CSettingsDlgSndio
 {
@@ -63,13 +64,10 @@ bool CSettingsDlgSndio::isValid(std::string device, bool capture)
 	if (!hit)
 		goto fin;
 
-	// sample rate check
+	// sample rate check, any rate the audio manager can resample from
 	for (i = 0, hit = false; i < SIO_NRATE && !hit; i++) {
-#ifdef USE44100
-		hit = (cap.rate[i] == 44100);
-#else
-		hit = (cap.rate[i] == 8000);
-#endif
+		for (unsigned int rate : AUDIO_RATES)
+			hit = hit || (cap.rate[i] == rate);
 	}
 	if (!hit)
 		goto fin;
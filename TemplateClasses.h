@@ -22,20 +22,53 @@
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <chrono>
+
+#include "Trace.h"
+
+// What Push() does when a queue with a capacity is full: block waits for
+// room, drop_oldest throws the front away, compress lets the queue grow
+// and the consumer merges items with PopOver() until it is back in size.
+enum class EQueuePolicy { block, drop_oldest, compress };
 
 template <class T> class CTQueue
 {
 public:
-	CTQueue() : q(), m(), c() {}
+	CTQueue() : q(), m(), c(), space(), capacity(0), policy(EQueuePolicy::block), overloads(0), dropped(0) {}
 
 	~CTQueue()
 	{
 		Clear();
 	}
 
-	void Push(T item)
+	// capacity 0 is no limit, the overload counts start again
+	void SetLimit(std::size_t cap, EQueuePolicy pol)
 	{
 		std::lock_guard<std::mutex> lock(m);
+		capacity = cap;
+		policy = pol;
+		overloads = dropped = 0;
+		space.notify_all();
+	}
+
+	void Push(const T &item)
+	{
+		std::unique_lock<std::mutex> lock(m);
+		if (capacity && q.size() >= capacity)
+		{
+			overloads++;
+			if (EQueuePolicy::block == policy)
+			{
+				TRACE_SPAN("queue full wait");
+				while (capacity && q.size() >= capacity)
+					space.wait(lock);
+			}
+			else if (EQueuePolicy::drop_oldest == policy)
+			{
+				q.pop();
+				dropped++;
+			}
+		}
 		q.push(item);
 		c.notify_one();
 	}
@@ -43,37 +76,92 @@ public:
 	T WaitPop()
 	{
 		std::unique_lock<std::mutex> lock(m);
-		while (q.empty())
+		if (q.empty())
 		{
-			c.wait(lock);
+			TRACE_SPAN("queue empty wait");
+			while (q.empty())
+				c.wait(lock);
 		}
-		T item = q.front();
+		T item = std::move(q.front());
 		q.pop();
+		space.notify_one();
 		return item;
 	}
 
+	bool TryPop(T &item)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (q.empty())
+			return false;
+		item = std::move(q.front());
+		q.pop();
+		space.notify_one();
+		return true;
+	}
+
+	// for the compress policy: the next item, if the queue is still at
+	// its capacity after the consumer's last pop, counted as dropped
+	bool PopOver(T &item)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (EQueuePolicy::compress != policy || 0 == capacity || q.size() < capacity)
+			return false;
+		item = std::move(q.front());
+		q.pop();
+		dropped++;
+		return true;
+	}
+
 	bool IsEmpty() const
 	{
 		std::unique_lock<std::mutex> lock(m);
 		return q.empty();
 	}
 
+	std::size_t Size() const
+	{
+		std::unique_lock<std::mutex> lock(m);
+		return q.size();
+	}
+
+	// pushes that found the queue full, and items dropped or merged
+	std::size_t Overloads() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return overloads;
+	}
+
+	std::size_t Dropped() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return dropped;
+	}
+
 	void Clear()
 	{
 		std::unique_lock<std::mutex> lock(m);
 		while (!q.empty())
 			q.pop();
+		space.notify_all();
 	}
 
 private:
 	std::queue<T> q;
 	mutable std::mutex m;
-	std::condition_variable c;
+	std::condition_variable c, space;
+	std::size_t capacity;
+	EQueuePolicy policy;
+	std::size_t overloads, dropped;
 };
 
+// A frame carries two timestamps for the latency statistics: origin,
+// when its audio came in from the mic or the network, and lap, when it
+// finished its last stage.  A frame made up along the way has neither.
 template <class T, int N> class CTFrame
 {
 public:
+	using clock = std::chrono::steady_clock;
+
 	CTFrame()
 	{
 		memset(data, 0, N * sizeof(T));
@@ -90,15 +178,60 @@ public:
 	{
 		memcpy(data, from.GetData(), N *sizeof(T));
 		flag = from.GetFlag();
+		origin = from.origin;
+		lap = from.lap;
 	}
 
 	CTFrame<T, N> &operator=(const CTFrame<T, N> &from)
 	{
 		memcpy(data, from.GetData(), N * sizeof(T));
 		flag = from.GetFlag();
+		origin = from.origin;
+		lap = from.lap;
 		return *this;
 	}
 
+	// the timestamps of another frame, e.g. the audio a codec frame is from
+	template <class F> void SetStamps(const F &from)
+	{
+		origin = from.GetOrigin();
+		lap = from.GetLap();
+	}
+
+	void SetOrigin(clock::time_point t = clock::now())
+	{
+		origin = lap = t;
+	}
+
+	bool Stamped() const
+	{
+		return clock::time_point() != origin;
+	}
+
+	clock::time_point GetOrigin() const
+	{
+		return origin;
+	}
+
+	clock::time_point GetLap() const
+	{
+		return lap;
+	}
+
+	// ms since the last lap, which is now
+	double Lap(clock::time_point t = clock::now())
+	{
+		const double ms = std::chrono::duration<double, std::milli>(t - lap).count();
+		lap = t;
+		return ms;
+	}
+
+	// ms since the origin
+	double Age(clock::time_point t = clock::now()) const
+	{
+		return std::chrono::duration<double, std::milli>(t - origin).count();
+	}
+
 	const T *GetData() const
 	{
 		return data;
@@ -122,10 +255,19 @@ public:
 private:
 	T data[N];
 	bool flag;
+	clock::time_point origin, lap;
 };
 
-// audio
-using CAudioFrame = CTFrame<short int, 160>;
+// audio, 20 ms at 8000Hz, float samples are full scale at -1.0 to 1.0
+using CAudioShortFrame = CTFrame<short int, 160>;
+using CAudioFloatFrame = CTFrame<float, 160>;
+#ifdef FLOAT_AUDIO
+using AUDIO_SAMPLE = float;
+using CAudioFrame = CAudioFloatFrame;
+#else
+using AUDIO_SAMPLE = short int;
+using CAudioFrame = CAudioShortFrame;
+#endif
 using CAudioQueue = CTQueue<CAudioFrame>;
 
 // M17
@@ -0,0 +1,175 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifdef USE_TRACE
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include <map>
+#include <memory>
+#include <iostream>
+
+#include "Trace.h"
+
+#define TRACE_RING 16384	// spans a thread keeps, the latest
+
+using STraceEvent = struct trace_event_tag
+{
+	const char *name, *thread;
+	uint64_t start, end;
+	uint32_t tid;
+};
+
+// A thread's ring.  Threads come and go with each over, so a ring is
+// handed on to the next thread when its owner exits, with its spans.
+using STraceRing = struct trace_ring_tag
+{
+	STraceEvent events[TRACE_RING];
+	std::atomic<uint64_t> head;	// spans written, ever
+	bool owned;
+};
+
+std::atomic<bool> CTrace::enabled(false);
+
+static std::mutex trace_mutex;	// for the ring list, never while recording
+static std::vector<std::unique_ptr<STraceRing>> rings;
+static std::atomic<uint32_t> next_tid(1);
+static std::atomic<uint64_t> epoch(0);	// when tracing was last switched on, ns
+
+class CTraceThread
+{
+public:
+	CTraceThread() : tid(next_tid++), name(nullptr), ring(nullptr) {}
+	~CTraceThread()
+	{
+		if (ring) {
+			std::lock_guard<std::mutex> lock(trace_mutex);
+			ring->owned = false;
+		}
+	}
+	STraceRing *Ring()
+	{
+		if (nullptr == ring) {
+			std::lock_guard<std::mutex> lock(trace_mutex);
+			for (auto &r : rings) {
+				if (! r->owned) {
+					ring = r.get();
+					break;
+				}
+			}
+			if (nullptr == ring) {
+				rings.emplace_back(new STraceRing);
+				ring = rings.back().get();
+				ring->head = 0;
+			}
+			ring->owned = true;
+		}
+		return ring;
+	}
+	const uint32_t tid;
+	const char *name;
+
+private:
+	STraceRing *ring;
+};
+
+static thread_local CTraceThread trace_thread;
+
+// The rings belong to their threads, they aren't cleared; a dump leaves
+// out the spans from before the epoch instead.
+void CTrace::Enable(bool on)
+{
+	if (on)
+		epoch = Now();
+	enabled = on;
+}
+
+// Each span carries the name, so it goes with the thread and a thread
+// that has ended leaves nothing behind but its spans.
+void CTrace::ThreadName(const char *name)
+{
+	trace_thread.name = name;
+}
+
+void CTrace::Record(const char *name, uint64_t start, uint64_t end)
+{
+	STraceRing *ring = trace_thread.Ring();
+	const uint64_t head = ring->head.load(std::memory_order_relaxed);
+	STraceEvent &ev = ring->events[head % TRACE_RING];
+	ev.name = name;
+	ev.thread = trace_thread.name;
+	ev.start = start;
+	ev.end = end;
+	ev.tid = trace_thread.tid;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Best switched off first, a span recorded while the rings are read may
+// come out torn.
+bool CTrace::Dump(const std::string &path)
+{
+	FILE *fp = fopen(path.c_str(), "w");
+	if (nullptr == fp) {
+		std::cerr << "ERROR: can't write the trace to " << path << std::endl;
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	const uint64_t from = epoch;
+	uint64_t origin = UINT64_MAX;
+	std::map<uint32_t, const char *> thread_names;
+	for (auto &r : rings) {
+		const uint64_t head = r->head.load(std::memory_order_acquire);
+		for (uint64_t i = (head > TRACE_RING) ? head - TRACE_RING : 0; i < head; i++) {
+			const STraceEvent &ev = r->events[i % TRACE_RING];
+			if (ev.start < from)
+				continue;
+			if (ev.start < origin)
+				origin = ev.start;
+			if (ev.thread)
+				thread_names[ev.tid] = ev.thread;
+		}
+	}
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+	const char *sep = "";
+	for (const auto &n : thread_names) {
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", sep, n.first, n.second);
+		sep = ",\n";
+	}
+	unsigned long count = 0;
+	for (auto &r : rings) {
+		const uint64_t head = r->head.load(std::memory_order_acquire);
+		for (uint64_t i = (head > TRACE_RING) ? head - TRACE_RING : 0; i < head; i++) {
+			const STraceEvent &ev = r->events[i % TRACE_RING];
+			if (ev.start < from)
+				continue;
+			fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", sep, ev.name, ev.tid, (ev.start - origin) / 1000.0, (ev.end - ev.start) / 1000.0);
+			sep = ",\n";
+			count++;
+		}
+	}
+	fputs("\n]}\n", fp);
+	if (fclose(fp)) {
+		std::cerr << "ERROR: can't write the trace to " << path << std::endl;
+		return true;
+	}
+	std::cout << "Trace of " << count << " spans written to " << path << std::endl;
+	return false;
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+// Trace spans for finding which thread stalled, built in with the TRACE
+// cmake option and otherwise compiled out.  TRACE_SPAN("name") times the
+// rest of its scope.  Each thread records into a ring of its own, no
+// locks, and only while tracing is on; CTrace::Dump() writes the rings as
+// Chrome trace-event JSON, for chrome://tracing or Perfetto.
+
+#ifdef USE_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class CTrace
+{
+public:
+	static void Enable(bool on);	// on starts a new trace, older spans are left out
+	static bool Enabled() { return enabled.load(std::memory_order_relaxed); }
+	static void ThreadName(const char *name);	// a string literal, kept by pointer
+	static void Record(const char *name, uint64_t start, uint64_t end);
+	static bool Dump(const std::string &path);	// returns true on failure
+	static uint64_t Now()	// ns
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+class CTraceSpan
+{
+public:
+	CTraceSpan(const char *span_name) : name(span_name), start(CTrace::Enabled() ? CTrace::Now() : 0) {}
+	~CTraceSpan()
+	{
+		if (start)
+			CTrace::Record(name, start, CTrace::Now());
+	}
+
+private:
+	const char *name;	// a string literal, it is kept by pointer
+	const uint64_t start;
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SPAN(name) CTraceSpan TRACE_JOIN(trace_span_, __LINE__)(name)
+#define TRACE_THREAD(name) CTrace::ThreadName(name)
+
+#else
+
+#define TRACE_SPAN(name)
+#define TRACE_THREAD(name)
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <thread>
+#include <iostream>
+
+#include "TxPacer.h"
+
+void CTxPacer::Reset()
+{
+	started = false;
+	frames = regrids = 0;
+	error_sum = error_max = 0.0;
+}
+
+void CTxPacer::Wait()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (! started) {
+		started = true;
+		deadline = now;
+	} else if (now <= deadline + period) {
+		std::this_thread::sleep_until(deadline);
+		now = std::chrono::steady_clock::now();
+	}
+	// measured against the deadline the frame was due at, even if it missed it
+	const double error = std::chrono::duration<double, std::milli>(now - deadline).count();
+	error_sum += error;
+	if (error > error_max)
+		error_max = error;
+	frames++;
+	if (now > deadline + period) {
+		deadline = now;	// the frame came too late for the grid
+		regrids++;
+	}
+	deadline += period;
+}
+
+void CTxPacer::Log(const char *name) const
+{
+	if (0 == frames)
+		return;
+	std::cout << "Audio " << name << " pacing " << frames << " frames, send jitter " << error_sum / frames << " ms mean, " << error_max << " ms max";
+	if (regrids)
+		std::cout << ", " << regrids << " frames too late for the grid";
+	std::cout << std::endl;
+}
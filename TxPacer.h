@@ -0,0 +1,44 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <chrono>
+
+// Releases transmit frames on a fixed 40 ms grid.  The grid starts at
+// the first frame and each Wait() sleeps until the frame's absolute
+// deadline, so sleep overshoot doesn't add up over an over.  A frame
+// that comes later than a whole period starts a new grid rather than
+// bursting to catch up.  The send error, how late each frame left
+// after its deadline, is the jitter Log() prints.
+
+class CTxPacer
+{
+public:
+	CTxPacer(std::chrono::nanoseconds frame_period = std::chrono::milliseconds(40)) : period(frame_period) { Reset(); }
+	void Reset();	// the next frame starts the grid
+	void Wait();	// until the next frame is due
+	void Log(const char *name) const;
+
+private:
+	const std::chrono::nanoseconds period;
+	std::chrono::steady_clock::time_point deadline;
+	bool started;
+	unsigned long frames, regrids;
+	double error_sum, error_max;	// ms
+};
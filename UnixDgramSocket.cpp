@@ -28,6 +28,7 @@
 #include <sys/types.h>
 
 #include "UnixDgramSocket.h"
+#include "Trace.h"
 
 #ifdef USE_NAMED_SOCKET
 #define SocketNamePtr(x) (x)
@@ -110,6 +111,7 @@ void CUnixDgramWriter::SetUp(const char *path)	// returns true on failure
 
 ssize_t CUnixDgramWriter::Write(const void *buf, size_t size)
 {
+	TRACE_SPAN("CUnixDgramWriter::Write");
 	// open the socket
 	int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
 	if (fd < 0) {
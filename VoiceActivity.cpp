@@ -0,0 +1,75 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "VoiceActivity.h"
+
+#define VAD_ONSET   7.94	// +9 dB over the noise floor starts voice
+#define VAD_RELEASE 3.98	// voice continues while above +6 dB
+#define VAD_MINIMUM 1.0e3	// -60 dBFS, the floor never goes below this
+#define VAD_HANGOVER 1600	// 200 ms at 8 kHz
+#define VAD_RISE    1.014	// per 20 ms, the floor rises at most 3 dB per second
+
+void CVoiceActivity::Reset()
+{
+	noise = VAD_MINIMUM;
+	hangover = 0;
+	active = false;
+}
+
+bool CVoiceActivity::IsVoice(const short *audio, int count)
+{
+	double ms = 0.0;
+	for (int i=0; i<count; i++)
+		ms += double(audio[i]) * double(audio[i]);
+	return update(ms / count, count);
+}
+
+// the levels above are for 16 bit samples
+bool CVoiceActivity::IsVoice(const float *audio, int count)
+{
+	double ms = 0.0;
+	for (int i=0; i<count; i++)
+		ms += double(audio[i]) * double(audio[i]);
+	return update(ms * 32768.0 * 32768.0 / count, count);
+}
+
+bool CVoiceActivity::update(double ms, int count)
+{
+	// track the floor, fast down and slow up, it starts at the minimum so
+	// a noisy mic is treated as voice until the floor has caught up
+	if (ms < noise) {
+		noise = 0.8 * noise + 0.2 * ms;
+	} else {
+		for (int i=0; i<count; i+=160)
+			noise *= VAD_RISE;
+		if (noise > ms)
+			noise = ms;
+	}
+	if (noise < VAD_MINIMUM)
+		noise = VAD_MINIMUM;
+
+	if (ms > VAD_ONSET * noise || (active && ms > VAD_RELEASE * noise)) {
+		active = true;
+		hangover = VAD_HANGOVER;
+	} else if (active) {
+		hangover -= count;
+		if (hangover <= 0)
+			active = false;
+	}
+	return active;
+}
@@ -0,0 +1,41 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+// An energy based voice activity detector for 8 kHz mic audio.
+// The noise floor follows the quietest recent frames. A frame more than
+// 9 dB above the floor starts voice, and voice only ends after 200 ms
+// below the 6 dB release level. The encoder looks one frame ahead, so the
+// frame before an onset is sent as voice too.
+
+class CVoiceActivity
+{
+public:
+	CVoiceActivity() { Reset(); }
+	void Reset();
+	bool IsVoice(const short *audio, int count);	// count is the number of samples in audio
+	bool IsVoice(const float *audio, int count);	// full scale is -1.0 to 1.0
+
+private:
+	bool update(double ms, int count);
+
+	double noise;	// noise floor estimate, mean square
+	int hangover;	// samples left before voice ends
+	bool active;
+};
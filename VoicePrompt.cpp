@@ -0,0 +1,131 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include "Packet.h"
+#include "VoicePrompt.h"
+
+bool CVoicePrompt::Load(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return true;
+	struct stat st;
+	if (fstat(fd, &st) || 0 == st.st_size) {
+		close(fd);
+		std::cerr << "ERROR: voice prompt " << path << " is empty" << std::endl;
+		return true;
+	}
+	const std::size_t size = st.st_size;
+	mtime = st.st_mtim;
+	ino = st.st_ino;
+	// one that is shorter by the time it is read is being written, it is
+	// read again when it has changed
+	data.resize(size);
+	std::size_t got = 0;
+	int err = 0;
+	while (got < size) {
+		const ssize_t n = read(fd, data.data() + got, size - got);
+		if (n < 0 && EINTR == errno)
+			continue;
+		if (n < 0)
+			err = errno;
+		if (n <= 0)
+			break;
+		got += n;
+	}
+	close(fd);
+	if (got < size) {
+		std::cerr << "ERROR: can't read voice prompt " << path << ": " << (err ? strerror(err) : "it is being written") << std::endl;
+		return true;
+	}
+
+	if (0 == path.compare(path.size() - 4, 4, ".m17")) {
+		if (size % sizeof(SM17Frame) || memcmp(data.data(), "M17 ", 4)) {
+			std::cerr << "ERROR: voice prompt " << path << " is not a stream of M17 frames" << std::endl;
+			return true;
+		}
+		SM17Frame frame;
+		memcpy(&frame, data.data(), sizeof(SM17Frame));
+		is_3200 = ((frame.GetFrameType() & 0x6u) == 0x4u);
+		stride = sizeof(SM17Frame);
+		offset = offsetof(SM17Frame, payload);
+		// up to the last frame
+		std::size_t count = 0;
+		while (count < size / sizeof(SM17Frame)) {
+			memcpy(&frame, data.data() + count * sizeof(SM17Frame), sizeof(SM17Frame));
+			count++;
+			if (frame.GetFrameNumber() & 0x8000u)
+				break;
+		}
+		frames = count * (is_3200 ? 2 : 1);
+	} else {
+		// raw frames carry no mode, <name>.1600.c2 is 1600 and <name>.c2 is 3200
+		if (path.size() > 8 && 0 == path.compare(path.size() - 8, 8, ".1600.c2")) {
+			is_3200 = false;
+			stride = 8;
+		}
+		frames = size / 8;	// a partial frame at the end is left out
+	}
+	return false;
+}
+
+bool CVoicePrompt::Same(const std::string &path) const
+{
+	struct stat st;
+	if (stat(path.c_str(), &st))
+		return false;
+	return st.st_ino == ino && st.st_mtim.tv_sec == mtime.tv_sec && st.st_mtim.tv_nsec == mtime.tv_nsec && std::size_t(st.st_size) == data.size();
+}
+
+const uint8_t *CVoicePrompt::Frame(std::size_t i) const
+{
+	const std::size_t per = is_3200 ? 2 : 1;
+	return data.data() + (i / per) * stride + offset + (i % per) * 8;
+}
+
+std::shared_ptr<const CVoicePrompt> CPromptCache::Get(const std::string &name)
+{
+	// a name, not a path
+	if (name.empty() || '.' == name[0] || std::string::npos != name.find('/'))
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(mux);
+	for (const char *ext : { ".m17", ".c2", ".1600.c2" }) {
+		const std::string path(dir + "/" + name + ext);
+		auto it = prompts.find(path);
+		if (prompts.end() != it && it->second->Same(path))
+			return it->second;
+		auto prompt = std::make_shared<CVoicePrompt>();
+		if (prompt->Load(path) || 0 == prompt->Frames()) {
+			if (prompts.end() != it)
+				prompts.erase(it);
+			continue;
+		}
+		prompts[path] = prompt;
+		return prompt;
+	}
+	return nullptr;
+}
@@ -0,0 +1,69 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include <ctime>
+
+// Voice prompts, pre-encoded with yamvoice-batch and kept in memory from
+// the prompt directory: <name>.m17, M17 stream frames of either mode,
+// <name>.c2, raw 3200 Codec2 frames, or <name>.1600.c2, raw 1600
+// Codec2 frames.  A prompt is read the first time it is asked for and
+// read again when the file has changed.  It is copied, not mapped, so a
+// file rewritten in place while it plays can't take the pages from
+// under it.
+
+class CVoicePrompt
+{
+public:
+	CVoicePrompt() : is_3200(true), frames(0), stride(16), offset(0), mtime{0, 0}, ino(0) {}
+	bool Load(const std::string &path);	// returns true on failure
+	bool Same(const std::string &path) const;	// the file hasn't changed since loaded
+
+	bool Is3200() const { return is_3200; }
+	std::size_t Frames() const { return frames; }	// 8 byte Codec2 frames
+	const uint8_t *Frame(std::size_t i) const;
+
+private:
+	std::vector<uint8_t> data;
+	bool is_3200;
+	std::size_t frames;
+	std::size_t stride, offset;	// where the Codec2 frames are, one or two per stride
+	struct timespec mtime;
+	ino_t ino;
+};
+
+class CPromptCache
+{
+public:
+	void SetDir(const std::string &directory) { dir.assign(directory); }
+	// the prompt, or nullptr if there is no such prompt
+	std::shared_ptr<const CVoicePrompt> Get(const std::string &name);
+
+private:
+	std::string dir;
+	std::mutex mux;
+	std::map<std::string, std::shared_ptr<const CVoicePrompt>> prompts;
+};
@@ -0,0 +1,146 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// yamvoice-guicheck: the GUI thread never waits on audio
+//
+// The echo test and PTT buttons queue their audio work on one task
+// thread, which runs it in order and reports back through Fl::awake(),
+// see CMainWindow::AudioTasks().  The GUI needs FLTK and a display, so
+// this check stands in for it: a loop with the 100 ms timer of
+// CMainWindow::StallCheck() presses the buttons, queues the same audio
+// calls in the same order on a task thread, and sees them finish through
+// flags where the window has Fl::awake() handlers.
+//
+// It records an echo, plays it back, then keys up and keys off.  The
+// check is that the loop is never late past the stall monitor's 100 ms
+// threshold.  How long each task ran is printed too: that is how long
+// the window froze when the buttons ran them inline.  With no gateway
+// running, the over's frames are refused, which doesn't hold it up.
+// Exits 1 on a failure.
+//
+// usage: yamvoice-guicheck [-s SECONDS] [-o FILE]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+#include "MainWindow.h"
+
+#define STALL_CHECK		std::chrono::milliseconds(100)	// the GUI's stall timer
+#define STALL_LIMIT		100.0	// ms, what the stall monitor reports
+
+using clock_type = std::chrono::steady_clock;
+
+void CMainWindow::Receive(bool)
+{
+}
+
+// what a button queues, and how long it ran on the task thread
+struct STask
+{
+	const char *name;
+	std::function<void()> work;
+	std::atomic<bool> done;
+	double ms;
+};
+
+int main(int argc, char *argv[])
+{
+	int secs = 1;
+	std::string path("guicheck.wav");
+	int opt;
+	while ((opt = getopt(argc, argv, "s:o:")) != -1) {
+		switch (opt) {
+			case 's': secs = atoi(optarg); break;
+			case 'o': path.assign(optarg); break;
+			default:
+				std::cerr << "usage: " << argv[0] << " [-s SECONDS] [-o FILE]" << std::endl;
+				return 2;
+		}
+	}
+	if (secs < 1) {
+		std::cerr << "ERROR: SECONDS must be at least 1" << std::endl;
+		return 2;
+	}
+
+	CMainWindow window;
+	CFGDATA data;
+	window.cfg.CopyTo(data);
+	data.sAudioIn.assign("file:");
+	data.sAudioOut.assign("file:" + path);
+	data.bAudioFast = false;
+	data.iPreRoll = 0;
+	window.cfg.CopyFrom(data);
+	if (window.AudioManager.Init(&window))
+		return 1;
+	CAudioManager &am = window.AudioManager;
+
+	// the presses, in order, each after the one before has finished and
+	// the talk time has passed
+	STask tasks[] = {
+		{ "echo_on", [&am]() { am.RecordMicThread(E_PTT_Type::echo, "ECHOTEST"); }, {false}, 0.0 },
+		{ "echo_off", [&am]() { am.PlayEchoDataThread(); }, {false}, 0.0 },
+		{ "ptt_on", [&am]() { am.RecordMicThread(E_PTT_Type::m17, "@ALL"); }, {false}, 0.0 },
+		{ "ptt_off", [&am]() { am.KeyOff(); }, {false}, 0.0 },
+	};
+	const bool talk[] = { true, false, true, false };	// wait SECONDS after it
+	const std::size_t count = sizeof(tasks) / sizeof(tasks[0]);
+
+	CTQueue<STask *> queue;
+	auto worker = std::async(std::launch::async, [&queue]() {
+		for (STask *task=queue.WaitPop(); task; task=queue.WaitPop()) {
+			const auto start = clock_type::now();
+			task->work();
+			task->ms = std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+			task->done = true;	// Fl::awake() in the window
+		}
+	});
+
+	// the event loop
+	double worst = 0.0;
+	std::size_t next = 0;
+	auto press = clock_type::now();
+	auto due = clock_type::now() + STALL_CHECK;
+	while (next < count || ! tasks[count-1].done) {
+		std::this_thread::sleep_until(due);
+		auto now = clock_type::now();
+		const double late = std::chrono::duration<double, std::milli>(now - due).count();
+		if (late > worst)
+			worst = late;
+		due = now + STALL_CHECK;
+		if (next < count && (0 == next || tasks[next-1].done) && now >= press) {
+			queue.Push(&tasks[next]);	// all a button callback does
+			press = now + (talk[next] ? std::chrono::seconds(secs) : std::chrono::seconds(0));
+			next++;
+		}
+	}
+	queue.Push(nullptr);
+	worker.get();
+
+	for (const auto &task : tasks)
+		printf("gui_task_%s: %.1f ms on the task thread\n", task.name, task.ms);
+	const bool ok = worst < STALL_LIMIT;
+	printf("gui_stall: longest event loop stall %.1f ms (limit %.0f ms): %s\n", worst, STALL_LIMIT, ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// yamvoice-rxcheck: two received streams, back to back
+//
+// Sends two 3200 streams through M17_2AudioMgr, paced at 40 ms a frame,
+// the second starting a few ms after the first one's last frame, while
+// the first is still playing out.  Playback goes to a file: device, and
+// the check is that the second stream joins the first one's receive
+// session and every 20 ms codec frame of both streams is in the WAV
+// file: the file holds at least both streams' samples, and at least that
+// many 20 ms blocks of it are audible.  A gap longer than the playout
+// tail starts a second session, which reopens the file, so that fails
+// too.  Exits 1 on a failure.
+//
+// usage: yamvoice-rxcheck [-s SECONDS] [-g GAP_MS] [-o FILE]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "MainWindow.h"
+#include "codec2.h"
+
+#define BLOCK	160	// samples in a 20 ms block at 8 kHz
+#define EDGE	2	// blocks a stream's start and end can leave quiet
+#define WAV_HEADER	44
+
+static int rx_on = 0, rx_off = 0;
+
+void CMainWindow::Receive(bool on)
+{
+	(on ? rx_on : rx_off)++;
+}
+
+// a 3200 stream of M17 frames, a tone so it is never quiet
+static std::vector<SM17Frame> MakeStream(unsigned short id, int frames, double hz)
+{
+	CCodec2 c2(true);
+	std::vector<SM17Frame> stream(frames);
+	short pcm[BLOCK];
+	for (int f=0; f<frames; f++) {
+		SM17Frame &m = stream[f];
+		memset(&m, 0, sizeof(m));
+		memcpy(m.magic, "M17 ", 4);
+		m.streamid = id;
+		m.SetFrameType(0x5u);
+		m.SetFrameNumber((f == frames - 1) ? (f | 0x8000u) : f);
+		for (int h=0; h<2; h++) {
+			for (int k=0; k<BLOCK; k++)
+				pcm[k] = short(8000.0 * sin(2.0 * M_PI * hz * ((2 * f + h) * BLOCK + k) / 8000.0));
+			c2.codec2_encode(m.payload + 8 * h, pcm);
+		}
+	}
+	return stream;
+}
+
+int main(int argc, char *argv[])
+{
+	int secs = 2, gap = 5;
+	std::string path("rxcheck.wav");
+	int opt;
+	while ((opt = getopt(argc, argv, "s:g:o:")) != -1) {
+		switch (opt) {
+			case 's': secs = atoi(optarg); break;
+			case 'g': gap = atoi(optarg); break;
+			case 'o': path.assign(optarg); break;
+			default:
+				std::cerr << "usage: " << argv[0] << " [-s SECONDS] [-g GAP_MS] [-o FILE]" << std::endl;
+				return 2;
+		}
+	}
+	if (secs < 1 || gap < 0) {
+		std::cerr << "ERROR: SECONDS must be at least 1 and GAP_MS can't be negative" << std::endl;
+		return 2;
+	}
+
+	CMainWindow window;
+	CFGDATA data;
+	window.cfg.CopyTo(data);
+	data.sAudioIn.assign("file:");
+	data.sAudioOut.assign("file:" + path);
+	data.bAudioFast = false;
+	data.iPreRoll = 0;
+	data.iRxStreams = 2;
+	window.cfg.CopyFrom(data);
+	if (window.AudioManager.Init(&window))
+		return 1;
+
+	const int frames = secs * 25;
+	const std::vector<SM17Frame> streams[2] = { MakeStream(0x1234u, frames, 440.0), MakeStream(0x1235u, frames, 660.0) };
+	auto next = std::chrono::steady_clock::now();
+	for (const auto &stream : streams) {
+		for (const auto &m : stream) {
+			window.AudioManager.M17_2AudioMgr(m);
+			next += std::chrono::milliseconds(40);
+			std::this_thread::sleep_until(next);
+		}
+		next += std::chrono::milliseconds(gap);
+		std::this_thread::sleep_until(next);
+	}
+	// let the session play out and close the file
+	std::this_thread::sleep_for(std::chrono::seconds(2));
+
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (nullptr == fp) {
+		std::cerr << "ERROR: can't open " << path << std::endl;
+		return 1;
+	}
+	fseek(fp, WAV_HEADER, SEEK_SET);
+	std::vector<short> pcm;
+	short buf[BLOCK];
+	size_t n;
+	while ((n = fread(buf, sizeof(short), BLOCK, fp)) > 0)
+		pcm.insert(pcm.end(), buf, buf + n);
+	fclose(fp);
+
+	long audible = 0;
+	for (size_t b=0; b+BLOCK<=pcm.size(); b+=BLOCK) {
+		double sum = 0.0;
+		for (int k=0; k<BLOCK; k++)
+			sum += double(pcm[b+k]) * pcm[b+k];
+		if (sqrt(sum / BLOCK) > 500.0)
+			audible++;
+	}
+
+	const long want = 2L * 2 * frames;	// 20 ms blocks in both streams
+	const bool samples_ok = long(pcm.size()) >= want * BLOCK;
+	const bool audible_ok = audible >= want - 2 * EDGE;
+	const bool session_ok = (1 == rx_on && 1 == rx_off);
+	printf("rx_samples: %zu written, both streams are %ld: %s\n", pcm.size(), want * BLOCK, samples_ok ? "PASS" : "FAIL");
+	printf("rx_audible: %ld blocks of 20 ms, both streams are %ld: %s\n", audible, want, audible_ok ? "PASS" : "FAIL");
+	printf("rx_sessions: Receive on %d, off %d, one session: %s\n", rx_on, rx_off, session_ok ? "PASS" : "FAIL");
+	return (samples_ok && audible_ok && session_ok) ? 0 : 1;
+}
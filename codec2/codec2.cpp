@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
 
@@ -83,6 +84,7 @@ CCodec2::CCodec2(bool is_3200)
 	c2.Fs = c2.c2const.Fs;
 	int n_samp = c2.n_samp = c2.c2const.n_samp;
 	int m_pitch = c2.m_pitch = c2.c2const.m_pitch;
+	assert(m_pitch <= CODEC2_ANALYSIS_M_PITCH);
 
 	c2.Pn.resize(2*n_samp);
 	c2.Sn_.resize(2*n_samp);
@@ -114,6 +116,7 @@ CCodec2::CCodec2(bool is_3200)
 		c2.prev_lsps_dec[i] = i*PI/(LPC_ORD+1);
 	}
 	c2.prev_e_dec = 1;
+	c2.rand_next = 1;
 
 	nlp.nlp_create(&c2.c2const);
 
@@ -126,6 +129,7 @@ CCodec2::CCodec2(bool is_3200)
 	c2.xq_dec[0] = c2.xq_dec[1] = 0.0;
 
 	c2.smoothing = 0;
+	c2.effort = CODEC2_EFFORT_FULL;
 
 	c2.bpf_buf.resize(BPF_N+4*c2.n_samp);
 	for(int i=0; i<BPF_N+4*c2.n_samp; i++)
@@ -134,22 +138,41 @@ CCodec2::CCodec2(bool is_3200)
 	c2.softdec = NULL;
 	c2.gray = 1;
 
+#ifdef CODEC2_PROFILE
+	profile_on = false;
+	codec2_profile_reset();
+#endif
+
 	// make sure that one of the two decode function pointers is empty
-	// for the encode function pointer this is not required since we always set it
-	// to a meaningful value
 
 	decode = NULL;
+	decode_float = NULL;
+
+#ifdef CODEC2_FIXED
+	codec2_fixed_create();
 
 	if ( 3200 == c2.mode)
 	{
-		encode = &CCodec2::codec2_encode_3200;
-		decode = &CCodec2::codec2_decode_3200;
+		decode = &CCodec2::codec2_decode_3200_fixed<short>;
+		decode_float = &CCodec2::codec2_decode_3200_fixed<float>;
+	}
+	else
+	{
+		decode = &CCodec2::codec2_decode_1600_fixed<short>;
+		decode_float = &CCodec2::codec2_decode_1600_fixed<float>;
+	}
+#else
+	if ( 3200 == c2.mode)
+	{
+		decode = &CCodec2::codec2_decode_3200<short>;
+		decode_float = &CCodec2::codec2_decode_3200<float>;
 	}
 	else
 	{
-		encode = &CCodec2::codec2_encode_1600;
-		decode = &CCodec2::codec2_decode_1600;
+		decode = &CCodec2::codec2_decode_1600<short>;
+		decode_float = &CCodec2::codec2_decode_1600<float>;
 	}
+#endif
 }
 
 /*---------------------------------------------------------------------------*\
@@ -214,11 +237,379 @@ int CCodec2::codec2_samples_per_frame()
 	return 0; /* shouldnt get here */
 }
 
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_set_effort
+
+  Trades encoder CPU for quality.  Only the analysis side is affected,
+  the bitstream format is unchanged and the decoder does the same work
+  at every level.
+
+  CODEC2_EFFORT_FULL     the reference encoder
+  CODEC2_EFFORT_REDUCED  the fine harmonic sum pitch refinement uses a
+                         0.5 sample step instead of 0.25
+  CODEC2_EFFORT_LOW      as REDUCED, and on the 10ms sub frames where only
+                         the voicing bit is sent the previous F0 is tried
+                         first, the NLP DFT and peak search only run if
+                         that comes out unvoiced
+
+  Phase estimation in estimate_amplitudes() is already disabled for
+  these modes and est_voicing_mbe() is a small part of the encoder, so
+  neither is varied.  Measured on an x86-64 host (gcc -O2) with 60s of
+  synthetic speech, quality compared to the FULL bitstream:
+
+    level    3200 us/frame  1600 us/frame  voicing same  |dWo| index
+    --------------------------------------------------------------------
+    FULL         55             105            100%         0
+    REDUCED      53             103           99.7%       0.51
+    LOW          48              91           96.3%       0.93
+
+  One Wo index is about 0.25 samples of pitch period at high pitch, so
+  most differences are within the refinement step.
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::codec2_set_effort(int effort)
+{
+	if (effort < CODEC2_EFFORT_FULL || effort > CODEC2_EFFORT_LOW)
+		effort = CODEC2_EFFORT_FULL;
+	c2.effort = effort;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_state_bytes, codec2_save_state, codec2_restore_state
+
+  Snapshot of the state that carries from one frame to the next, so a
+  stream can be suspended and resumed, a late decoder warm started or
+  a segment encoder seeded.  Encoding or decoding after a restore gives
+  exactly the bits or samples the saved instance would have produced.
+
+  parts selects CODEC2_STATE_ENCODER (speech history, pitch tracker and
+  NLP filter memories) and/or CODEC2_STATE_DECODER (interpolation
+  memories, phase track, post filter estimate, overlap add buffer and
+  the random number generator).  Settings such as the effort level are
+  not part of the state.
+
+  The snapshot is in host byte order with a four byte header (magic,
+  version, parts and build flags).  codec2_restore_state() returns
+  false and leaves the instance alone if the header does not match
+  this mode and build or nbytes is wrong.
+
+\*---------------------------------------------------------------------------*/
+
+#define STATE_VERSION 1
+#define STATE_1600    0x04
+#define STATE_FIXED   0x08
+
+static unsigned char *state_put(unsigned char *p, const void *v, size_t n)
+{
+	memcpy(p, v, n);
+	return p + n;
+}
+
+static const unsigned char *state_get(const unsigned char *p, void *v, size_t n)
+{
+	memcpy(v, p, n);
+	return p + n;
+}
+
+int CCodec2::codec2_state_bytes(int parts)
+{
+	int nbytes = 4;
+
+	if (parts & CODEC2_STATE_ENCODER)
+	{
+		nbytes += c2.m_pitch*sizeof(float);		/* Sn          */
+		nbytes += 3*sizeof(float);				/* prev_f0_enc, xq_enc[2] */
+		nbytes += nlp.nlp_state_bytes();
+	}
+	if (parts & CODEC2_STATE_DECODER)
+	{
+		nbytes += sizeof(uint64_t);				/* rand_next   */
+		nbytes += 2*sizeof(int);				/* prev model  */
+#ifdef CODEC2_FIXED
+		nbytes += 4*sizeof(int32_t) + LPC_ORD*sizeof(int32_t);
+		nbytes += 2*c2.n_samp*sizeof(int32_t);
+#else
+		nbytes += 6*sizeof(float) + LPC_ORD*sizeof(float);
+		nbytes += 2*c2.n_samp*sizeof(float);
+#endif
+	}
+	return nbytes;
+}
+
+static unsigned char state_flags(int mode, int parts)
+{
+	unsigned char flags = parts & CODEC2_STATE_ALL;
+
+	if (1600 == mode)
+		flags |= STATE_1600;
+#ifdef CODEC2_FIXED
+	flags |= STATE_FIXED;
+#endif
+	return flags;
+}
+
+void CCodec2::codec2_save_state(unsigned char *state, int parts)
+{
+	unsigned char *p = state;
+
+	*p++ = 'C';
+	*p++ = '2';
+	*p++ = STATE_VERSION;
+	*p++ = state_flags(c2.mode, parts);
+
+	if (parts & CODEC2_STATE_ENCODER)
+	{
+		p = state_put(p, c2.Sn.data(), c2.m_pitch*sizeof(float));
+		p = state_put(p, &c2.prev_f0_enc, sizeof(float));
+		p = state_put(p, c2.xq_enc, 2*sizeof(float));
+		nlp.nlp_save_state(p);
+		p += nlp.nlp_state_bytes();
+	}
+	if (parts & CODEC2_STATE_DECODER)
+	{
+		uint64_t rand_next = c2.rand_next;
+
+		p = state_put(p, &rand_next, sizeof(uint64_t));
+#ifdef CODEC2_FIXED
+		p = state_put(p, &c2.prev_model_dec_fx.Wo, sizeof(uint32_t));
+		p = state_put(p, &c2.prev_model_dec_fx.L, sizeof(int));
+		p = state_put(p, &c2.prev_model_dec_fx.voiced, sizeof(int));
+		p = state_put(p, &c2.ex_phase_fx, sizeof(uint32_t));
+		p = state_put(p, &c2.bg_est_fx, sizeof(int32_t));
+		p = state_put(p, &c2.prev_e_dec_fx, sizeof(int32_t));
+		p = state_put(p, c2.prev_lsps_dec_fx, LPC_ORD*sizeof(int32_t));
+		p = state_put(p, c2.Sn_fx.data(), 2*c2.n_samp*sizeof(int32_t));
+#else
+		p = state_put(p, &c2.prev_model_dec.Wo, sizeof(float));
+		p = state_put(p, &c2.prev_model_dec.L, sizeof(int));
+		p = state_put(p, &c2.prev_model_dec.voiced, sizeof(int));
+		p = state_put(p, &c2.ex_phase, sizeof(float));
+		p = state_put(p, &c2.bg_est, sizeof(float));
+		p = state_put(p, &c2.prev_e_dec, sizeof(float));
+		p = state_put(p, c2.xq_dec, 2*sizeof(float));
+		p = state_put(p, c2.prev_lsps_dec, LPC_ORD*sizeof(float));
+		p = state_put(p, c2.Sn_.data(), 2*c2.n_samp*sizeof(float));
+#endif
+	}
+
+	assert(p - state == codec2_state_bytes(parts));
+}
+
+bool CCodec2::codec2_restore_state(const unsigned char *state, int nbytes)
+{
+	if (nbytes < 4 || 'C' != state[0] || '2' != state[1] || STATE_VERSION != state[2])
+		return false;
+
+	int parts = state[3] & CODEC2_STATE_ALL;
+	if (state[3] != state_flags(c2.mode, parts) || nbytes != codec2_state_bytes(parts))
+		return false;
+
+	const unsigned char *p = state + 4;
+
+	if (parts & CODEC2_STATE_ENCODER)
+	{
+		p = state_get(p, c2.Sn.data(), c2.m_pitch*sizeof(float));
+		p = state_get(p, &c2.prev_f0_enc, sizeof(float));
+		p = state_get(p, c2.xq_enc, 2*sizeof(float));
+		nlp.nlp_restore_state(p);
+		p += nlp.nlp_state_bytes();
+	}
+	if (parts & CODEC2_STATE_DECODER)
+	{
+		uint64_t rand_next;
+
+		p = state_get(p, &rand_next, sizeof(uint64_t));
+		c2.rand_next = rand_next;
+#ifdef CODEC2_FIXED
+		p = state_get(p, &c2.prev_model_dec_fx.Wo, sizeof(uint32_t));
+		p = state_get(p, &c2.prev_model_dec_fx.L, sizeof(int));
+		p = state_get(p, &c2.prev_model_dec_fx.voiced, sizeof(int));
+		p = state_get(p, &c2.ex_phase_fx, sizeof(uint32_t));
+		p = state_get(p, &c2.bg_est_fx, sizeof(int32_t));
+		p = state_get(p, &c2.prev_e_dec_fx, sizeof(int32_t));
+		p = state_get(p, c2.prev_lsps_dec_fx, LPC_ORD*sizeof(int32_t));
+		p = state_get(p, c2.Sn_fx.data(), 2*c2.n_samp*sizeof(int32_t));
+#else
+		p = state_get(p, &c2.prev_model_dec.Wo, sizeof(float));
+		p = state_get(p, &c2.prev_model_dec.L, sizeof(int));
+		p = state_get(p, &c2.prev_model_dec.voiced, sizeof(int));
+		p = state_get(p, &c2.ex_phase, sizeof(float));
+		p = state_get(p, &c2.bg_est, sizeof(float));
+		p = state_get(p, &c2.prev_e_dec, sizeof(float));
+		p = state_get(p, c2.xq_dec, 2*sizeof(float));
+		p = state_get(p, c2.prev_lsps_dec, LPC_ORD*sizeof(float));
+		p = state_get(p, c2.Sn_.data(), 2*c2.n_samp*sizeof(float));
+#endif
+	}
+
+	return true;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_stage_name, codec2_profile_enable, codec2_profile_reset
+
+  When built with CODEC2_PROFILE the stages listed in codec2.h are timed
+  with CODEC2_STAGE() while profiling is enabled, codec2_profile() has
+  the totals.  Profiling starts disabled so timing the whole frame is
+  not disturbed by the clock reads.
+
+\*---------------------------------------------------------------------------*/
+
+const char *CCodec2::codec2_stage_name(int stage)
+{
+	static const char *names[C2_STAGES] = {
+		"nlp", "dft_speech", "two_stage_pitch_refinement", "estimate_amplitudes",
+		"est_voicing_mbe", "lpc_to_lsp", "aks_to_M2", "synthesise"
+	};
+
+	return (stage >= 0 && stage < C2_STAGES) ? names[stage] : "";
+}
+
+#ifdef CODEC2_PROFILE
+void CCodec2::codec2_profile_enable(bool on)
+{
+	profile_on = on;
+}
+
+void CCodec2::codec2_profile_reset()
+{
+	memset(&profile, 0, sizeof(profile));
+}
+#endif
+
 void CCodec2::codec2_encode(unsigned char *bits, const short *speech)
 {
-	assert(encode != NULL);
+	C2ANALYSIS analysis;
+
+	analyse_frames(&analysis, speech);
+	codec2_quantise(bits, &analysis);
+}
+
+void CCodec2::codec2_encode(unsigned char *bits, const float *speech)
+{
+	C2ANALYSIS analysis;
+
+	analyse_frames(&analysis, speech);
+	codec2_quantise(bits, &analysis);
+}
 
-	(*this.*encode)(bits, speech);
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_analyse
+                codec2_quantise
+
+  The two halves of codec2_encode().  codec2_analyse() updates the
+  encoder history and estimates the model parameters, codec2_quantise()
+  only reads the analysis and the constant window, so it can run on
+  another thread for frame n while codec2_analyse() works on frame
+  n+1.  The bits are identical to codec2_encode().
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::codec2_analyse(C2ANALYSIS *analysis, const short *speech)
+{
+	analyse_frames(analysis, speech);
+}
+
+void CCodec2::codec2_analyse(C2ANALYSIS *analysis, const float *speech)
+{
+	analyse_frames(analysis, speech);
+}
+
+template <class S> void CCodec2::analyse_frames(C2ANALYSIS *analysis, const S *speech)
+{
+	MODEL   model;
+	int     i;
+	int     nsub = codec2_samples_per_frame() / c2.n_samp;
+
+	/* the odd sub frames carry Wo, E and the LSPs, which are
+	   quantised from the speech history as it was after them */
+
+	for(i=0; i<nsub; i++)
+	{
+		speech_in(&speech[i*c2.n_samp]);
+		analyse_one_frame(&model, 0 == i%2);
+		analysis->voiced[i] = model.voiced;
+		if (i%2)
+		{
+			analysis->Wo[i/2] = model.Wo;
+			memcpy(analysis->Sn[i/2], c2.Sn.data(), c2.m_pitch*sizeof(float));
+		}
+	}
+	analysis->silent = false;
+}
+
+void CCodec2::codec2_quantise(unsigned char *bits, C2ANALYSIS *analysis)
+{
+	static const unsigned char silent_3200[8] = { 0x01, 0x00, 0x09, 0x43, 0x9c, 0xe4, 0x21, 0x08 };
+	static const unsigned char silent_1600[8] = { 0x01, 0x00, 0x04, 0x00, 0x25, 0x75, 0xdd, 0xf2 };
+
+	if (analysis->silent)
+		memcpy(bits, (3200 == c2.mode) ? silent_3200 : silent_1600, 8);
+	else if (3200 == c2.mode)
+		codec2_quantise_3200(bits, analysis);
+	else
+		codec2_quantise_1600(bits, analysis);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_encode_silence
+                codec2_analyse_silence
+
+  Used in place of codec2_encode() and codec2_analyse() for frames the
+  caller already knows are silent.  The speech still goes through the
+  analysis and NLP filter memories, so the next frame sees current
+  history, but no model parameters are estimated.  The bits are the
+  canonical silent frame for the mode, the same one sent on stream
+  timeouts.
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::codec2_encode_silence(unsigned char *bits, const short *speech)
+{
+	C2ANALYSIS analysis;
+
+	analyse_silence(&analysis, speech);
+	codec2_quantise(bits, &analysis);
+}
+
+void CCodec2::codec2_encode_silence(unsigned char *bits, const float *speech)
+{
+	C2ANALYSIS analysis;
+
+	analyse_silence(&analysis, speech);
+	codec2_quantise(bits, &analysis);
+}
+
+void CCodec2::codec2_analyse_silence(C2ANALYSIS *analysis, const short *speech)
+{
+	analyse_silence(analysis, speech);
+}
+
+void CCodec2::codec2_analyse_silence(C2ANALYSIS *analysis, const float *speech)
+{
+	analyse_silence(analysis, speech);
+}
+
+template <class S> void CCodec2::analyse_silence(C2ANALYSIS *analysis, const S *speech)
+{
+	float   pitch;
+	int     j;
+	int     n_samp = c2.n_samp;
+
+	for(j=0; j<codec2_samples_per_frame(); j+=n_samp)
+	{
+		speech_in(&speech[j]);
+		CODEC2_STAGE(C2_STAGE_NLP, nlp.nlp_filter(c2.Sn.data(), n_samp));
+		CODEC2_STAGE(C2_STAGE_NLP, nlp.nlp_skip(&pitch, &c2.prev_f0_enc));
+	}
+
+	analysis->silent = true;
 }
 
 void CCodec2::codec2_decode(short *speech, const unsigned char *bits)
@@ -228,14 +619,80 @@ void CCodec2::codec2_decode(short *speech, const unsigned char *bits)
 	(*this.*decode)(speech, bits);
 }
 
+void CCodec2::codec2_decode(float *speech, const unsigned char *bits)
+{
+	assert(decode_float != NULL);
+
+	(*this.*decode_float)(speech, bits);
+}
+
+/*---------------------------------------------------------------------------*
+  FUNCTION....: speech_in, speech_out
+
+  The only conversions between the caller's samples and the float model
+  scale of +/-32767: speech_in() shifts one sub frame into the analysis
+  history, speech_out() writes the last synthesised sub frame.  Short
+  output is clipped, float output is already limited by
+  ear_protection().
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::speech_in(const short *speech)
+{
+	int     i;
+	int     n_samp = c2.n_samp;
+	int     m_pitch = c2.m_pitch;
+
+	for(i=0; i<m_pitch-n_samp; i++)
+		c2.Sn[i] = c2.Sn[i+n_samp];
+	for(i=0; i<n_samp; i++)
+		c2.Sn[i+m_pitch-n_samp] = speech[i];
+}
+
+void CCodec2::speech_in(const float *speech)
+{
+	int     i;
+	int     n_samp = c2.n_samp;
+	int     m_pitch = c2.m_pitch;
+
+	for(i=0; i<m_pitch-n_samp; i++)
+		c2.Sn[i] = c2.Sn[i+n_samp];
+	for(i=0; i<n_samp; i++)
+		c2.Sn[i+m_pitch-n_samp] = speech[i] * 32768.0f;
+}
+
+void CCodec2::speech_out(short speech[])
+{
+	int     i;
+
+	for(i=0; i<c2.n_samp; i++)
+	{
+		if (c2.Sn_[i] > 32767.0)
+			speech[i] = 32767;
+		else if (c2.Sn_[i] < -32767.0)
+			speech[i] = -32767;
+		else
+			speech[i] = c2.Sn_[i];
+	}
+}
+
+void CCodec2::speech_out(float speech[])
+{
+	int     i;
+
+	for(i=0; i<c2.n_samp; i++)
+		speech[i] = c2.Sn_[i] * (1.0f / 32768.0f);
+}
+
 
 /*---------------------------------------------------------------------------*\
 
-  FUNCTION....: codec2_encode_3200
+  FUNCTION....: codec2_quantise_3200
   AUTHOR......: David Rowe
   DATE CREATED: 13 Sep 2012
 
-  Encodes 160 speech samples (20ms of speech) into 64 bits.
+  Quantises and packs the analysis of 160 speech samples (20ms of
+  speech) into 64 bits.
 
   The codec2 algorithm actually operates internally on 10ms (80
   sample) frames, so we run the encoding algorithm twice.  On the
@@ -255,9 +712,8 @@ void CCodec2::codec2_decode(short *speech, const unsigned char *bits)
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::codec2_encode_3200(unsigned char *bits, const short *speech)
+void CCodec2::codec2_quantise_3200(unsigned char *bits, C2ANALYSIS *analysis)
 {
-	MODEL   model;
 	float   ak[LPC_ORD+1];
 	float   lsps[LPC_ORD];
 	float   e;
@@ -270,17 +726,15 @@ void CCodec2::codec2_encode_3200(unsigned char *bits, const short *speech)
 
 	/* first 10ms analysis frame - we just want voicing */
 
-	analyse_one_frame(&model, speech);
-	qt.pack(bits, &nbit, model.voiced, 1);
+	qt.pack(bits, &nbit, analysis->voiced[0], 1);
 
 	/* second 10ms analysis frame */
 
-	analyse_one_frame(&model, &speech[c2.n_samp]);
-	qt.pack(bits, &nbit, model.voiced, 1);
-	Wo_index = qt.encode_Wo(&c2.c2const, model.Wo, WO_BITS);
+	qt.pack(bits, &nbit, analysis->voiced[1], 1);
+	Wo_index = qt.encode_Wo(&c2.c2const, analysis->Wo[0], WO_BITS);
 	qt.pack(bits, &nbit, Wo_index, WO_BITS);
 
-	e = qt.speech_to_uq_lsps(lsps, ak, c2.Sn.data(), c2.w.data(), c2.m_pitch, LPC_ORD);
+	CODEC2_STAGE(C2_STAGE_LSP, e = qt.speech_to_uq_lsps(lsps, ak, analysis->Sn[0], c2.w.data(), c2.m_pitch, LPC_ORD));
 	e_index = qt.encode_energy(e, E_BITS);
 	qt.pack(bits, &nbit, e_index, E_BITS);
 
@@ -303,7 +757,7 @@ void CCodec2::codec2_encode_3200(unsigned char *bits, const short *speech)
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::codec2_decode_3200(short speech[], const unsigned char * bits)
+template <class S> void CCodec2::codec2_decode_3200(S speech[], const unsigned char * bits)
 {
 	MODEL   model[2];
 	int     lspd_indexes[LPC_ORD];
@@ -359,9 +813,10 @@ void CCodec2::codec2_decode_3200(short speech[], const unsigned char * bits)
 	for(i=0; i<2; i++)
 	{
 		lsp_to_lpc(&lsps[i][0], &ak[i][0], LPC_ORD);
-		qt.aks_to_M2(&(c2.fftr_fwd_cfg), &ak[i][0], LPC_ORD, &model[i], e[i], &snr, 0, c2.lpc_pf, c2.bass_boost, c2.beta, c2.gamma, Aw);
+		CODEC2_STAGE(C2_STAGE_AKS_TO_M2, qt.aks_to_M2(&(c2.fftr_fwd_cfg), &ak[i][0], LPC_ORD, &model[i], e[i], &snr, 0, c2.lpc_pf, c2.bass_boost, c2.beta, c2.gamma, Aw));
 		qt.apply_lpc_correction(&model[i]);
-		synthesise_one_frame(&speech[c2.n_samp*i], &model[i], Aw, 1.0);
+		synthesise_one_frame(&model[i], Aw, 1.0);
+		speech_out(&speech[c2.n_samp*i]);
 	}
 
 	/* update memories for next frame ----------------------------*/
@@ -374,11 +829,12 @@ void CCodec2::codec2_decode_3200(short speech[], const unsigned char * bits)
 
 /*---------------------------------------------------------------------------*\
 
-  FUNCTION....: codec2_encode_1600
+  FUNCTION....: codec2_quantise_1600
   AUTHOR......: David Rowe
   DATE CREATED: Feb 28 2013
 
-  Encodes 320 speech samples (40ms of speech) into 64 bits.
+  Quantises and packs the analysis of 320 speech samples (40ms of
+  speech) into 64 bits.
 
   The codec2 algorithm actually operates internally on 10ms (80
   sample) frames, so we run the encoding algorithm 4 times:
@@ -400,9 +856,8 @@ void CCodec2::codec2_decode_3200(short speech[], const unsigned char * bits)
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::codec2_encode_1600(unsigned char * bits, const short speech[])
+void CCodec2::codec2_quantise_1600(unsigned char * bits, C2ANALYSIS *analysis)
 {
-	MODEL   model;
 	float   lsps[LPC_ORD];
 	float   ak[LPC_ORD+1];
 	float   e;
@@ -415,36 +870,32 @@ void CCodec2::codec2_encode_1600(unsigned char * bits, const short speech[])
 
 	/* frame 1: - voicing ---------------------------------------------*/
 
-	analyse_one_frame(&model, speech);
-	qt.pack(bits, &nbit, model.voiced, 1);
+	qt.pack(bits, &nbit, analysis->voiced[0], 1);
 
 	/* frame 2: - voicing, scalar Wo & E -------------------------------*/
 
-	analyse_one_frame(&model, &speech[c2.n_samp]);
-	qt.pack(bits, &nbit, model.voiced, 1);
+	qt.pack(bits, &nbit, analysis->voiced[1], 1);
 
-	Wo_index = qt.encode_Wo(&c2.c2const, model.Wo, WO_BITS);
+	Wo_index = qt.encode_Wo(&c2.c2const, analysis->Wo[0], WO_BITS);
 	qt.pack(bits, &nbit, Wo_index, WO_BITS);
 
 	/* need to run this just to get LPC energy */
-	e = qt.speech_to_uq_lsps(lsps, ak, c2.Sn.data(), c2.w.data(), c2.m_pitch, LPC_ORD);
+	CODEC2_STAGE(C2_STAGE_LSP, e = qt.speech_to_uq_lsps(lsps, ak, analysis->Sn[0], c2.w.data(), c2.m_pitch, LPC_ORD));
 	e_index = qt.encode_energy(e, E_BITS);
 	qt.pack(bits, &nbit, e_index, E_BITS);
 
 	/* frame 3: - voicing ---------------------------------------------*/
 
-	analyse_one_frame(&model, &speech[2*c2.n_samp]);
-	qt.pack(bits, &nbit, model.voiced, 1);
+	qt.pack(bits, &nbit, analysis->voiced[2], 1);
 
 	/* frame 4: - voicing, scalar Wo & E, scalar LSPs ------------------*/
 
-	analyse_one_frame(&model, &speech[3*c2.n_samp]);
-	qt.pack(bits, &nbit, model.voiced, 1);
+	qt.pack(bits, &nbit, analysis->voiced[3], 1);
 
-	Wo_index = qt.encode_Wo(&c2.c2const, model.Wo, WO_BITS);
+	Wo_index = qt.encode_Wo(&c2.c2const, analysis->Wo[1], WO_BITS);
 	qt.pack(bits, &nbit, Wo_index, WO_BITS);
 
-	e = qt.speech_to_uq_lsps(lsps, ak, c2.Sn.data(), c2.w.data(), c2.m_pitch, LPC_ORD);
+	CODEC2_STAGE(C2_STAGE_LSP, e = qt.speech_to_uq_lsps(lsps, ak, analysis->Sn[1], c2.w.data(), c2.m_pitch, LPC_ORD));
 	e_index = qt.encode_energy(e, E_BITS);
 	qt.pack(bits, &nbit, e_index, E_BITS);
 
@@ -468,7 +919,7 @@ void CCodec2::codec2_encode_1600(unsigned char * bits, const short speech[])
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::codec2_decode_1600(short speech[], const unsigned char * bits)
+template <class S> void CCodec2::codec2_decode_1600(S speech[], const unsigned char * bits)
 {
 	MODEL   model[4];
 	int     lsp_indexes[LPC_ORD];
@@ -541,9 +992,10 @@ void CCodec2::codec2_decode_1600(short speech[], const unsigned char * bits)
 	for(i=0; i<4; i++)
 	{
 		lsp_to_lpc(&lsps[i][0], &ak[i][0], LPC_ORD);
-		qt.aks_to_M2(&(c2.fftr_fwd_cfg), &ak[i][0], LPC_ORD, &model[i], e[i], &snr, 0, c2.lpc_pf, c2.bass_boost, c2.beta, c2.gamma, Aw);
+		CODEC2_STAGE(C2_STAGE_AKS_TO_M2, qt.aks_to_M2(&(c2.fftr_fwd_cfg), &ak[i][0], LPC_ORD, &model[i], e[i], &snr, 0, c2.lpc_pf, c2.bass_boost, c2.beta, c2.gamma, Aw));
 		qt.apply_lpc_correction(&model[i]);
-		synthesise_one_frame(&speech[c2.n_samp*i], &model[i], Aw, 1.0);
+		synthesise_one_frame(&model[i], Aw, 1.0);
+		speech_out(&speech[c2.n_samp*i]);
 	}
 
 	/* update memories for next frame ----------------------------*/
@@ -565,7 +1017,7 @@ void CCodec2::codec2_decode_1600(short speech[], const unsigned char * bits)
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::synthesise_one_frame(short speech[], MODEL *model, std::complex<float> Aw[], float gain)
+void CCodec2::synthesise_one_frame(MODEL *model, std::complex<float> Aw[], float gain)
 {
 	int     i;
 
@@ -575,7 +1027,7 @@ void CCodec2::synthesise_one_frame(short speech[], MODEL *model, std::complex<fl
 	phase_synth_zero_order(c2.n_samp, model, &c2.ex_phase, H);
 
 	postfilter(model, &c2.bg_est);
-	synthesise(c2.n_samp, &(c2.fftr_inv_cfg), c2.Sn_.data(), model, c2.Pn.data(), 1);
+	CODEC2_STAGE(C2_STAGE_SYNTHESISE, synthesise(c2.n_samp, &(c2.fftr_inv_cfg), c2.Sn_.data(), model, c2.Pn.data(), 1));
 
 	for(i=0; i<c2.n_samp; i++)
 	{
@@ -583,17 +1035,6 @@ void CCodec2::synthesise_one_frame(short speech[], MODEL *model, std::complex<fl
 	}
 
 	ear_protection(c2.Sn_.data(), c2.n_samp);
-
-	for(i=0; i<c2.n_samp; i++)
-	{
-		if (c2.Sn_[i] > 32767.0)
-			speech[i] = 32767;
-		else if (c2.Sn_[i] < -32767.0)
-			speech[i] = -32767;
-		else
-			speech[i] = c2.Sn_[i];
-	}
-
 }
 
 
@@ -603,39 +1044,53 @@ void CCodec2::synthesise_one_frame(short speech[], MODEL *model, std::complex<fl
   AUTHOR......: David Rowe
   DATE CREATED: 23/8/2010
 
-  Extract sinusoidal model parameters from 80 speech samples (10ms of
-  speech).
+  Extract sinusoidal model parameters from the 80 speech samples (10ms
+  of speech) speech_in() just added to the history.  voicing_only is
+  set for the sub frames where only the voicing bit is transmitted, see
+  codec2_set_effort().
 
 \*---------------------------------------------------------------------------*/
 
-void CCodec2::analyse_one_frame(MODEL *model, const short *speech)
+void CCodec2::analyse_one_frame(MODEL *model, bool voicing_only)
 {
 	std::complex<float>    Sw[FFT_ENC];
 	float   pitch;
-	int     i;
 	int     n_samp = c2.n_samp;
-	int     m_pitch = c2.m_pitch;
 
-	/* Read input speech */
+	CODEC2_STAGE(C2_STAGE_DFT, dft_speech(&c2.c2const, c2.fft_fwd_cfg, Sw, c2.Sn.data(), c2.w.data()));
 
-	for(i=0; i<m_pitch-n_samp; i++)
-		c2.Sn[i] = c2.Sn[i+n_samp];
-	for(i=0; i<n_samp; i++)
-		c2.Sn[i+m_pitch-n_samp] = speech[i];
+	CODEC2_STAGE(C2_STAGE_NLP, nlp.nlp_filter(c2.Sn.data(), n_samp));
 
-	dft_speech(&c2.c2const, c2.fft_fwd_cfg, Sw, c2.Sn.data(), c2.w.data());
+	/* On voicing only sub frames at low effort try the previous F0
+	   first, and only run the full pitch search if that comes out
+	   unvoiced */
+
+	if (voicing_only && CODEC2_EFFORT_LOW == c2.effort)
+	{
+		pitch = (float)c2.c2const.Fs / c2.prev_f0_enc;
+		model->Wo = TWO_PI/pitch;
+		model->L = PI/model->Wo;
+		CODEC2_STAGE(C2_STAGE_REFINE, two_stage_pitch_refinement(&c2.c2const, model, Sw));
+		CODEC2_STAGE(C2_STAGE_AMPLITUDES, estimate_amplitudes(model, Sw, 0));
+		CODEC2_STAGE(C2_STAGE_VOICING, est_voicing_mbe(&c2.c2const, model, Sw, c2.W));
+		if (model->voiced)
+		{
+			CODEC2_STAGE(C2_STAGE_NLP, nlp.nlp_skip(&pitch, &c2.prev_f0_enc));
+			return;
+		}
+	}
 
 	/* Estimate pitch */
-	nlp.nlp(c2.Sn.data(), n_samp, &pitch, &c2.prev_f0_enc);
+	CODEC2_STAGE(C2_STAGE_NLP, nlp.nlp_search(&pitch, &c2.prev_f0_enc));
 	model->Wo = TWO_PI/pitch;
 	model->L = PI/model->Wo;
 
 	/* estimate model parameters */
-	two_stage_pitch_refinement(&c2.c2const, model, Sw);
+	CODEC2_STAGE(C2_STAGE_REFINE, two_stage_pitch_refinement(&c2.c2const, model, Sw));
 
 	/* estimate phases when doing ML experiments */
-	estimate_amplitudes(model, Sw, 0);
-	est_voicing_mbe(&c2.c2const, model, Sw, c2.W);
+	CODEC2_STAGE(C2_STAGE_AMPLITUDES, estimate_amplitudes(model, Sw, 0));
+	CODEC2_STAGE(C2_STAGE_VOICING, est_voicing_mbe(&c2.c2const, model, Sw, c2.W));
 }
 
 
@@ -1158,7 +1613,7 @@ void CCodec2::two_stage_pitch_refinement(C2CONST *c2const, MODEL *model, std::co
 
 	pmax = TWO_PI/model->Wo + 1;
 	pmin = TWO_PI/model->Wo - 1;
-	pstep = 0.25;
+	pstep = (CODEC2_EFFORT_FULL == c2.effort) ? 0.25 : 0.5;
 	hs_pitch_refinement(model,Sw,pmin,pmax,pstep);
 
 	/* Limit range */
@@ -1514,9 +1969,8 @@ void CCodec2::synthesise(
 
 int CCodec2::codec2_rand(void)
 {
-	static unsigned long next = 1;
-	next = next * 1103515245 + 12345;
-	return((unsigned)(next/65536) % 32768);
+	c2.rand_next = c2.rand_next * 1103515245 + 12345;
+	return((unsigned)(c2.rand_next/65536) % 32768);
 }
 
 /*---------------------------------------------------------------------------*\
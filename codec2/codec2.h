@@ -40,21 +40,83 @@
 #define CODEC2_MODE_3200 	0
 #define CODEC2_MODE_1600 	2
 
+/* encoder effort levels, see codec2_set_effort() */
+
+#define CODEC2_EFFORT_FULL 	0
+#define CODEC2_EFFORT_REDUCED	1
+#define CODEC2_EFFORT_LOW	2
+
 #ifndef CODEC2_MODE_EN_DEFAULT
 #define CODEC2_MODE_EN_DEFAULT 1
 #endif
 
 #define CODEC2_RAND_MAX 32767
 
+/* parts of the state for codec2_save_state() */
+
+#define CODEC2_STATE_ENCODER	1
+#define CODEC2_STATE_DECODER	2
+#define CODEC2_STATE_ALL	(CODEC2_STATE_ENCODER | CODEC2_STATE_DECODER)
+
+/* output of codec2_analyse(), input of codec2_quantise() */
+
+#define CODEC2_ANALYSIS_M_PITCH 320	/* pitch analysis window at 8 kHz */
+
+using C2ANALYSIS = struct c2analysis_tag {
+	bool  silent;                            /* from codec2_analyse_silence()     */
+	int   voiced[4];                         /* voicing of each 10ms sub frame    */
+	float Wo[2];                             /* Wo of the 2nd and 4th sub frames  */
+	float Sn[2][CODEC2_ANALYSIS_M_PITCH];    /* speech history after them         */
+};
+
+/* encoder and decoder stages timed when built with CODEC2_PROFILE */
+
+enum {
+	C2_STAGE_NLP,                            /* Cnlp pitch estimator              */
+	C2_STAGE_DFT,                            /* dft_speech()                      */
+	C2_STAGE_REFINE,                         /* two_stage_pitch_refinement()      */
+	C2_STAGE_AMPLITUDES,                     /* estimate_amplitudes()             */
+	C2_STAGE_VOICING,                        /* est_voicing_mbe()                 */
+	C2_STAGE_LSP,                            /* LPC analysis and lpc_to_lsp()     */
+	C2_STAGE_AKS_TO_M2,                      /* aks_to_M2()                       */
+	C2_STAGE_SYNTHESISE,                     /* synthesise()                      */
+	C2_STAGES
+};
+
+using C2PROFILE = struct c2profile_tag {
+	unsigned long long ns[C2_STAGES];        /* total time in each stage          */
+	unsigned long long calls[C2_STAGES];
+};
+
 class CCodec2
 {
 public:
 	CCodec2(bool is_3200);
 	~CCodec2();
 	void codec2_encode(unsigned char *bits, const short *speech_in);
+	void codec2_encode_silence(unsigned char *bits, const short *speech_in);
+	void codec2_analyse(C2ANALYSIS *analysis, const short *speech_in);
+	void codec2_analyse_silence(C2ANALYSIS *analysis, const short *speech_in);
+	void codec2_quantise(unsigned char *bits, C2ANALYSIS *analysis);
 	void codec2_decode(short *speech_out, const unsigned char *bits);
+	/* the same with float speech, full scale is -1.0 to 1.0 */
+	void codec2_encode(unsigned char *bits, const float *speech_in);
+	void codec2_encode_silence(unsigned char *bits, const float *speech_in);
+	void codec2_analyse(C2ANALYSIS *analysis, const float *speech_in);
+	void codec2_analyse_silence(C2ANALYSIS *analysis, const float *speech_in);
+	void codec2_decode(float *speech_out, const unsigned char *bits);
 	int  codec2_samples_per_frame();
 	int  codec2_bits_per_frame();
+	void codec2_set_effort(int effort);
+	int  codec2_state_bytes(int parts);
+	void codec2_save_state(unsigned char *state, int parts);
+	bool codec2_restore_state(const unsigned char *state, int nbytes);
+	static const char *codec2_stage_name(int stage);
+#ifdef CODEC2_PROFILE
+	void codec2_profile_enable(bool on);
+	void codec2_profile_reset();
+	const C2PROFILE &codec2_profile() const { return profile; }
+#endif
 
 private:
 	// merged from other files
@@ -79,20 +141,66 @@ private:
 	float interp_energy(float prev, float next);
 	void interpolate_lsp_ver2(float interp[], float prev[],  float next[], float weight, int order);
 
-	void analyse_one_frame(MODEL *model, const short *speech);
-	void synthesise_one_frame(short speech[], MODEL *model, std::complex<float> Aw[], float gain);
-	void codec2_encode_3200(unsigned char *bits, const short *speech);
-	void codec2_encode_1600(unsigned char *bits, const short *speech);
-	void codec2_decode_3200(short *speech, const unsigned char *bits);
-	void codec2_decode_1600(short *speech, const unsigned char *bits);
+	/* S, the speech sample type, is short or float */
+	void speech_in(const short *speech);
+	void speech_in(const float *speech);
+	void speech_out(short speech[]);
+	void speech_out(float speech[]);
+	template <class S> void analyse_frames(C2ANALYSIS *analysis, const S *speech);
+	template <class S> void analyse_silence(C2ANALYSIS *analysis, const S *speech);
+	void analyse_one_frame(MODEL *model, bool voicing_only);
+	void synthesise_one_frame(MODEL *model, std::complex<float> Aw[], float gain);
+	void codec2_quantise_3200(unsigned char *bits, C2ANALYSIS *analysis);
+	void codec2_quantise_1600(unsigned char *bits, C2ANALYSIS *analysis);
+	template <class S> void codec2_decode_3200(S *speech, const unsigned char *bits);
+	template <class S> void codec2_decode_1600(S *speech, const unsigned char *bits);
 	void ear_protection(float in_out[], int n);
 	void lsp_to_lpc(float *freq, float *ak, int lpcrdr);
 
-	void (CCodec2::*encode)(unsigned char *bits, const short *speech);
+#ifdef CODEC2_FIXED
+	// fixed point decoder, codec2_fixed.cpp
+	void codec2_fixed_create();
+	uint32_t decode_Wo_fixed(int index);
+	int32_t decode_energy_fixed(int index);
+	void interp_Wo_fixed(MODEL_FX *interp, MODEL_FX *prev, MODEL_FX *next);
+	void lsp_to_lpc_fixed(int32_t *lsp, int32_t *ak, int order);
+	void aks_to_M2_fixed(int32_t ak[], int order, MODEL_FX *model, int32_t E, FX_COMPLEX Aw[]);
+	void synthesise_one_frame_fixed(MODEL_FX *model, FX_COMPLEX Aw[]);
+	void speech_out_fixed(short speech[]);
+	void speech_out_fixed(float speech[]);
+	template <class S> void codec2_decode_3200_fixed(S *speech, const unsigned char *bits);
+	template <class S> void codec2_decode_1600_fixed(S *speech, const unsigned char *bits);
+	CFixed fx;
+#endif
+
 	void (CCodec2::*decode)(short *speech, const unsigned char *bits);
+	void (CCodec2::*decode_float)(float *speech, const unsigned char *bits);
 	Cnlp nlp;
 	CQuantize qt;
 	CODEC2 c2;
+#ifdef CODEC2_PROFILE
+	C2PROFILE profile;
+	bool profile_on;
+#endif
 };
 
+/* CODEC2_STAGE(stage, call) runs call, timing it when profiling is on */
+
+#ifdef CODEC2_PROFILE
+#include <chrono>
+#define CODEC2_STAGE(stage, call) \
+	do { \
+		if (profile_on) { \
+			auto stage_start = std::chrono::steady_clock::now(); \
+			call; \
+			profile.ns[stage] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stage_start).count(); \
+			profile.calls[stage]++; \
+		} else { \
+			call; \
+		} \
+	} while (0)
+#else
+#define CODEC2_STAGE(stage, call) call
+#endif
+
 #endif
@@ -0,0 +1,635 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: codec2_fixed.cpp
+
+  Fixed point Codec2 3200 and 1600 decoders, built in place of the
+  float decoders when CODEC2_FIXED is defined.  They follow
+  codec2_decode_3200() and codec2_decode_1600() step by step, with
+  amplitudes and the LPC power spectrum kept as log2 values so the
+  large dynamic range of 1/|A(w)|^2 fits in 32 bits, and phases kept
+  as turns so they wrap without any arithmetic.  The encoder is
+  unchanged.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  Copyright (C) 2026 by agent
+
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef CODEC2_FIXED
+
+#include <math.h>
+
+#include "codec2.h"
+#include "codec2_internal.h"
+
+/* log2 constants in Q16, from the float decoder's constants */
+
+#define LOG2_10_Q16        217706	/* log2(10)                               */
+#define LPCPF_BETA_Q16      13107	/* LPCPF_BETA                             */
+#define BASS_BOOST_Q16      63626	/* log2(1.4*1.4)                          */
+#define LPC_CORR_Q16     (-325438)	/* log2(0.032), apply_lpc_correction()    */
+#define BG_THRESH_Q16      870824	/* BG_THRESH dB as log2 power             */
+#define BG_MARGIN_Q16      130624	/* BG_MARGIN dB as log2 power             */
+#define LSP_SWAP_HZ_Q16   8344303	/* 0.1 rad, check_lsp_order()             */
+#define LPC_CORR_WO     80530637u	/* PI*150/4000 rad as turns Q32           */
+
+#define PW_FLOOR_Q40      1099512	/* 1E-6 in Q40, added to |A|^2            */
+
+#define A_Q 4		/* synthesised amplitudes and speech are Q4 */
+
+/* LSPs are kept in Hz Q16, this is the same angle in turns Q32 */
+
+static inline uint32_t lsp_turn(int32_t hz_q16)
+{
+	return (uint32_t)(((int64_t)hz_q16 * 8192) / 1000);
+}
+
+/* turns Q32 of rand()/CODEC2_RAND_MAX of a full turn */
+
+static inline uint32_t rand_turn(int r)
+{
+	return (uint32_t)(((uint64_t)r << 32) / CODEC2_RAND_MAX);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_fixed_create
+
+  Called from the constructor.  Converts the synthesis window and the
+  LSP codebooks once, so the per frame path has no float maths.
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::codec2_fixed_create()
+{
+	int i, j;
+	int n_samp = c2.n_samp;
+
+	c2.Pn_fx.resize(2*n_samp);
+	c2.Sn_fx.resize(2*n_samp);
+	for(i=0; i<2*n_samp; i++)
+	{
+		c2.Pn_fx[i] = lroundf(c2.Pn[i] * 32768.0f);
+		c2.Sn_fx[i] = 0;
+	}
+
+	for(i=0; i<LPC_ORD; i++)
+	{
+		c2.lsp_cb_fx[i].resize(lsp_cb[i].m);
+		for(j=0; j<lsp_cb[i].m; j++)
+			c2.lsp_cb_fx[i][j] = lroundf(lsp_cb[i].cb[j*lsp_cb[i].k] * 65536.0f);
+		c2.lspd_cb_fx[i].resize(lsp_cbd[i].m);
+		for(j=0; j<lsp_cbd[i].m; j++)
+			c2.lspd_cb_fx[i][j] = lroundf(lsp_cbd[i].cb[j*lsp_cbd[i].k] * 65536.0f);
+	}
+
+	c2.ex_phase_fx = 0;
+	c2.bg_est_fx = 0;
+	c2.prev_e_dec_fx = 0;	/* log2(1) */
+	for(i=0; i<LPC_ORD; i++)
+		c2.prev_lsps_dec_fx[i] = (int32_t)(((int64_t)i * 4000 << 16) / (LPC_ORD+1));
+	c2.prev_model_dec_fx.Wo = (uint32_t)((1ull << 32) / c2.c2const.p_max);
+	c2.prev_model_dec_fx.L = 0x80000000u / c2.prev_model_dec_fx.Wo;
+	c2.prev_model_dec_fx.voiced = 0;
+	for(i=1; i<=MAX_AMP; i++)
+		c2.prev_model_dec_fx.lA[i] = FIXED_LOG_ZERO;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  Parameter decoding and interpolation, see decode_Wo(), decode_energy(),
+  interp_Wo() and interp_energy().
+
+\*---------------------------------------------------------------------------*/
+
+uint32_t CCodec2::decode_Wo_fixed(int index)
+{
+	uint32_t Wo_min = (uint32_t)((1ull << 32) / c2.c2const.p_max);
+	uint32_t Wo_max = (uint32_t)((1ull << 32) / c2.c2const.p_min);
+
+	return Wo_min + (uint32_t)(((uint64_t)(Wo_max - Wo_min) * index) >> WO_BITS);
+}
+
+int32_t CCodec2::decode_energy_fixed(int index)
+{
+	/* E_MIN_DB + index*(E_MAX_DB - E_MIN_DB)/E_LEVELS, as log2 of power */
+
+	int64_t db_x_levels = (int64_t)E_MIN_DB*E_LEVELS + (int64_t)(E_MAX_DB - E_MIN_DB)*index;
+
+	return (int32_t)((db_x_levels * LOG2_10_Q16) / (10*E_LEVELS));
+}
+
+void CCodec2::interp_Wo_fixed(MODEL_FX *interp, MODEL_FX *prev, MODEL_FX *next)
+{
+	uint32_t Wo_min = (uint32_t)((1ull << 32) / c2.c2const.p_max);
+
+	/* trap corner case where voicing est is probably wrong */
+
+	if (interp->voiced && !prev->voiced && !next->voiced)
+		interp->voiced = 0;
+
+	/* Wo depends on voicing of this and adjacent frames */
+
+	if (interp->voiced)
+	{
+		if (prev->voiced && next->voiced)
+			interp->Wo = (uint32_t)(((uint64_t)prev->Wo + next->Wo) >> 1);
+		if (!prev->voiced && next->voiced)
+			interp->Wo = next->Wo;
+		if (prev->voiced && !next->voiced)
+			interp->Wo = prev->Wo;
+	}
+	else
+	{
+		interp->Wo = Wo_min;
+	}
+	interp->L = 0x80000000u / interp->Wo;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: lsp_to_lpc_fixed
+
+  lsp_to_lpc() with LSPs in Hz Q16 and LPCs out in Q20.  The polynomial
+  states are Q24 in 64 bits.
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::lsp_to_lpc_fixed(int32_t *lsp, int32_t *ak, int order)
+{
+	int i,j;
+	int64_t xout1,xout2,xin1,xin2;
+	int64_t *pw,*n1,*n2,*n3,*n4 = 0;
+	int64_t freq[order];
+	int64_t Wp[(order * 4) + 2];
+
+	/* convert to the x=cos(w) domain */
+
+	for(i=0; i<order; i++)
+		freq[i] = fx.cos_q30(lsp_turn(lsp[i])) >> 6;
+
+	pw = Wp;
+
+	for(i=0; i<=4*(order/2)+1; i++)
+	{
+		*pw++ = 0;
+	}
+
+	pw = Wp;
+	xin1 = 1 << 24;
+	xin2 = 1 << 24;
+
+	for(j=0; j<=order; j++)
+	{
+		for(i=0; i<(order/2); i++)
+		{
+			n1 = pw+(i*4);
+			n2 = n1 + 1;
+			n3 = n2 + 1;
+			n4 = n3 + 1;
+			xout1 = xin1 - ((2*freq[2*i] * *n1 + (1 << 23)) >> 24) + *n2;
+			xout2 = xin2 - ((2*freq[2*i+1] * *n3 + (1 << 23)) >> 24) + *n4;
+			*n2 = *n1;
+			*n4 = *n3;
+			*n1 = xin1;
+			*n3 = xin2;
+			xin1 = xout1;
+			xin2 = xout2;
+		}
+		xout1 = xin1 + *(n4+1);
+		xout2 = xin2 - *(n4+2);
+		ak[j] = (int32_t)((xout1 + xout2 + (1 << 4)) >> 5);	/* half, and Q24 to Q20 */
+		*(n4+1) = xin1;
+		*(n4+2) = xin2;
+
+		xin1 = 0;
+		xin2 = 0;
+	}
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: aks_to_M2_fixed
+
+  aks_to_M2() followed by lpc_post_filter(), with E and the band
+  energies as log2 values.  In the log domain the post filter
+  Pw *= (Ww*Pw)^beta is a multiply add per bin, the only linear sums
+  are the energy totals, done in block floating point by log2_sum().
+  Also applies apply_lpc_correction().
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::aks_to_M2_fixed(int32_t ak[], int order, MODEL_FX *model, int32_t E, FX_COMPLEX Aw[])
+{
+	int32_t    x[FIXED_FFT_SIZE];
+	FX_COMPLEX Ww[FIXED_FFT_SIZE/2+1];
+	int32_t    Pw[FIXED_FFT_SIZE/2];	/* log2 P(w) Q16 */
+	int32_t    Pf[FIXED_FFT_SIZE/2];	/* log2 P(w) after the post filter */
+	int        i, m, am, bm;
+
+	/* Determine DFT of A(exp(jw)) and P(w) = 1/|A(exp(jw))|^2 */
+
+	for(i=0; i<FIXED_FFT_SIZE; i++)
+		x[i] = 0;
+	for(i=0; i<=order; i++)
+		x[i] = ak[i];
+	fx.fftr(x, Aw);
+
+	for(i=0; i<FIXED_FFT_SIZE/2; i++)
+	{
+		uint64_t a2 = (uint64_t)((int64_t)Aw[i].re*Aw[i].re) + (uint64_t)((int64_t)Aw[i].im*Aw[i].im);
+		Pw[i] = (40 << 16) - fx.log2_q16(a2 + PW_FLOOR_Q40);	/* Aw is Q20 */
+	}
+
+	if (c2.lpc_pf)
+	{
+		/* weighting filter W(exp(jw)), coefficients ak[i]*gamma^i */
+
+		int64_t coeff = (int64_t)(c2.gamma * (1 << 30));
+		int64_t gamma = coeff;
+		x[0] = ak[0];
+		for(i=1; i<=order; i++)
+		{
+			x[i] = (int32_t)((ak[i] * coeff) >> 30);
+			coeff = (coeff * gamma) >> 30;
+		}
+		fx.fftr(x, Ww);
+
+		for(i=0; i<FIXED_FFT_SIZE/2; i++)
+		{
+			uint64_t w2 = (uint64_t)((int64_t)Ww[i].re*Ww[i].re) + (uint64_t)((int64_t)Ww[i].im*Ww[i].im);
+			if (0 == w2)
+			{
+				Pf[i] = FIXED_LOG_ZERO;
+			}
+			else
+			{
+				int32_t lw2 = fx.log2_q16(w2) - (40 << 16);
+				Pf[i] = Pw[i] + (int32_t)(((int64_t)(lw2 + Pw[i]) * LPCPF_BETA_Q16) >> 16);
+			}
+		}
+
+		/* normalise energy to the LPC energy */
+
+		int32_t gain = fx.log2_sum(Pw, FIXED_FFT_SIZE/2) - fx.log2_sum(Pf, FIXED_FFT_SIZE/2) + E;
+		for(i=0; i<FIXED_FFT_SIZE/2; i++)
+			if (FIXED_LOG_ZERO != Pf[i])
+				Pw[i] = Pf[i] + gain;
+			else
+				Pw[i] = FIXED_LOG_ZERO;
+
+		if (c2.bass_boost)
+		{
+			/* add 3dB to first 1 kHz to account for LP effect of PF */
+
+			for(i=0; i<FIXED_FFT_SIZE/8; i++)
+				if (FIXED_LOG_ZERO != Pw[i])
+					Pw[i] += BASS_BOOST_Q16;
+		}
+	}
+	else
+	{
+		for(i=0; i<FIXED_FFT_SIZE/2; i++)
+			Pw[i] += E;
+	}
+
+	/* Determine magnitudes from P(w), A = sqrt(band energy) */
+
+	for(m=1; m<=model->L; m++)
+	{
+		am = (int)((((uint64_t)(2*m - 1) * model->Wo * (FIXED_FFT_SIZE/2)) + 0x80000000u) >> 32);
+		bm = (int)((((uint64_t)(2*m + 1) * model->Wo * (FIXED_FFT_SIZE/2)) + 0x80000000u) >> 32);
+		if (bm > FIXED_FFT_SIZE/2)
+			bm = FIXED_FFT_SIZE/2;
+
+		if (bm > am)
+			model->lA[m] = fx.log2_sum(&Pw[am], bm - am) / 2;
+		else
+			model->lA[m] = FIXED_LOG_ZERO;
+	}
+
+	/* apply_lpc_correction() */
+
+	if (model->Wo < LPC_CORR_WO && FIXED_LOG_ZERO != model->lA[1])
+		model->lA[1] += LPC_CORR_Q16;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: synthesise_one_frame_fixed
+
+  sample_phase(), phase_synth_zero_order(), postfilter(), synthesise()
+  and ear_protection() for one 10ms frame.  The phase of H(w) is just
+  minus the phase of A(w), so the excitation phase is added as turns
+  instead of going through complex multiplies and atan2().
+
+\*---------------------------------------------------------------------------*/
+
+void CCodec2::synthesise_one_frame_fixed(MODEL_FX *model, FX_COMPLEX Aw[])
+{
+	int        i, j, m, b;
+	int        n_samp = c2.n_samp;
+	int32_t   *Sn_ = c2.Sn_fx.data();
+	int32_t   *Pn = c2.Pn_fx.data();
+	FX_COMPLEX Sw_[FIXED_FFT_SIZE/2+1];
+	int32_t    sw_[FIXED_FFT_SIZE];
+
+	/* phase_synth_zero_order() with sample_phase() */
+
+	c2.ex_phase_fx += model->Wo * n_samp;
+
+	for(m=1; m<=model->L; m++)
+	{
+		b = (int)((((uint64_t)m * model->Wo * FIXED_FFT_SIZE) + 0x80000000u) >> 32);
+		uint32_t H_phase = -fx.atan2_turn(Aw[b].im, Aw[b].re);
+
+		if (model->voiced)
+			model->phi[m] = H_phase + c2.ex_phase_fx * m;
+		else
+			model->phi[m] = H_phase + rand_turn(codec2_rand());
+	}
+
+	/* postfilter(), bg_est is the log2 of the power */
+
+	int32_t e = FIXED_LOG_ZERO;
+	{
+		int32_t A2[MAX_AMP+1];
+		for(m=1; m<=model->L; m++)
+			A2[m] = (FIXED_LOG_ZERO == model->lA[m]) ? FIXED_LOG_ZERO : 2*model->lA[m];
+		e = fx.log2_sum(&A2[1], model->L);
+		if (FIXED_LOG_ZERO != e)
+			e -= fx.log2_q16(model->L);
+	}
+
+	if ((e < BG_THRESH_Q16) && !model->voiced && FIXED_LOG_ZERO != e)
+		c2.bg_est_fx += (e - c2.bg_est_fx) / 10;	/* BG_BETA */
+
+	int32_t thresh = (c2.bg_est_fx + BG_MARGIN_Q16) / 2;	/* log2 amplitude */
+	if (model->voiced)
+		for(m=1; m<=model->L; m++)
+			if (model->lA[m] < thresh)
+				model->phi[m] = rand_turn(codec2_rand());
+
+	/* synthesise() */
+
+	for(i=0; i<n_samp-1; i++)
+		Sn_[i] = Sn_[i+n_samp];
+	Sn_[n_samp-1] = 0;
+
+	for(i=0; i<FIXED_FFT_SIZE/2+1; i++)
+	{
+		Sw_[i].re = 0;
+		Sw_[i].im = 0;
+	}
+
+	for(m=1; m<=model->L; m++)
+	{
+		b = (int)((((uint64_t)m * model->Wo * FIXED_FFT_SIZE) + 0x80000000u) >> 32);
+		if (b > ((FIXED_FFT_SIZE/2)-1))
+			b = (FIXED_FFT_SIZE/2)-1;
+
+		uint64_t A = fx.exp2_q16(model->lA[m] + (A_Q << 16));
+		if (A > (1u << 24))
+			A = 1u << 24;
+		Sw_[b].re = (int32_t)(((int64_t)A * fx.cos_q30(model->phi[m])) >> 30);
+		Sw_[b].im = (int32_t)(((int64_t)A * fx.sin_q30(model->phi[m])) >> 30);
+	}
+
+	fx.fftri(Sw_, sw_);
+
+	/* Overlap add to previous samples */
+
+	for(i=0; i<n_samp-1; i++)
+		Sn_[i] += (int32_t)(((int64_t)sw_[FIXED_FFT_SIZE-n_samp+1+i] * Pn[i]) >> 15);
+	for(i=n_samp-1,j=0; i<2*n_samp; i++,j++)
+		Sn_[i] = (int32_t)(((int64_t)sw_[j] * Pn[i]) >> 15);
+
+	/* ear_protection() */
+
+	int32_t max_sample = 0;
+	for(i=0; i<n_samp; i++)
+		if (Sn_[i] > max_sample)
+			max_sample = Sn_[i];
+
+	if (max_sample > (30000 << A_Q))
+	{
+		int64_t inv_over = ((int64_t)30000 << (A_Q + 15)) / max_sample;	/* Q15 */
+		int64_t gain = (inv_over * inv_over) >> 15;
+		for(i=0; i<n_samp; i++)
+			Sn_[i] = (int32_t)((Sn_[i] * gain) >> 15);
+	}
+}
+
+/* see speech_out() */
+
+void CCodec2::speech_out_fixed(short speech[])
+{
+	int        i;
+	int32_t   *Sn_ = c2.Sn_fx.data();
+
+	for(i=0; i<c2.n_samp; i++)
+	{
+		int32_t s = Sn_[i] / (1 << A_Q);
+		if (s > 32767)
+			speech[i] = 32767;
+		else if (s < -32767)
+			speech[i] = -32767;
+		else
+			speech[i] = s;
+	}
+}
+
+void CCodec2::speech_out_fixed(float speech[])
+{
+	int        i;
+	int32_t   *Sn_ = c2.Sn_fx.data();
+
+	for(i=0; i<c2.n_samp; i++)
+		speech[i] = Sn_[i] * (1.0f / (32768 << A_Q));
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_decode_3200_fixed
+
+  Fixed point codec2_decode_3200().
+
+\*---------------------------------------------------------------------------*/
+
+template <class S> void CCodec2::codec2_decode_3200_fixed(S speech[], const unsigned char * bits)
+{
+	MODEL_FX   model[2];
+	int        lspd_indexes[LPC_ORD];
+	int32_t    lsps[2][LPC_ORD];
+	int32_t    e[2];
+	int32_t    ak[LPC_ORD+1];
+	int        Wo_index, e_index;
+	int        i;
+	unsigned int nbit = 0;
+	FX_COMPLEX Aw[FIXED_FFT_SIZE/2+1];
+
+	/* unpack bits from channel ------------------------------------*/
+
+	model[0].voiced = qt.unpack(bits, &nbit, 1);
+	model[1].voiced = qt.unpack(bits, &nbit, 1);
+
+	Wo_index = qt.unpack(bits, &nbit, WO_BITS);
+	model[1].Wo = decode_Wo_fixed(Wo_index);
+	model[1].L  = 0x80000000u / model[1].Wo;
+
+	e_index = qt.unpack(bits, &nbit, E_BITS);
+	e[1] = decode_energy_fixed(e_index);
+
+	for(i=0; i<LSPD_SCALAR_INDEXES; i++)
+	{
+		lspd_indexes[i] = qt.unpack(bits, &nbit, qt.lspd_bits(i));
+	}
+	for(i=0; i<LPC_ORD; i++)
+	{
+		lsps[1][i] = c2.lspd_cb_fx[i][lspd_indexes[i]];
+		if (i)
+			lsps[1][i] += lsps[1][i-1];
+	}
+
+	/* interpolate ------------------------------------------------*/
+
+	interp_Wo_fixed(&model[0], &c2.prev_model_dec_fx, &model[1]);
+	e[0] = (c2.prev_e_dec_fx + e[1]) / 2;
+
+	for(i=0; i<LPC_ORD; i++)
+		lsps[0][i] = (int32_t)(((int64_t)c2.prev_lsps_dec_fx[i] + lsps[1][i]) / 2);
+
+	for(i=0; i<2; i++)
+	{
+		lsp_to_lpc_fixed(&lsps[i][0], ak, LPC_ORD);
+		CODEC2_STAGE(C2_STAGE_AKS_TO_M2, aks_to_M2_fixed(ak, LPC_ORD, &model[i], e[i], Aw));
+		CODEC2_STAGE(C2_STAGE_SYNTHESISE, synthesise_one_frame_fixed(&model[i], Aw));
+		speech_out_fixed(&speech[c2.n_samp*i]);
+	}
+
+	/* update memories for next frame ----------------------------*/
+
+	c2.prev_model_dec_fx = model[1];
+	c2.prev_e_dec_fx = e[1];
+	for(i=0; i<LPC_ORD; i++)
+		c2.prev_lsps_dec_fx[i] = lsps[1][i];
+}
+
+/*---------------------------------------------------------------------------*\
+
+  FUNCTION....: codec2_decode_1600_fixed
+
+  Fixed point codec2_decode_1600().
+
+\*---------------------------------------------------------------------------*/
+
+template <class S> void CCodec2::codec2_decode_1600_fixed(S speech[], const unsigned char * bits)
+{
+	MODEL_FX   model[4];
+	int        lsp_indexes[LPC_ORD];
+	int32_t    lsps[4][LPC_ORD];
+	int32_t    e[4];
+	int32_t    ak[LPC_ORD+1];
+	int        Wo_index, e_index;
+	int        i;
+	unsigned int nbit = 0;
+	FX_COMPLEX Aw[FIXED_FFT_SIZE/2+1];
+
+	/* unpack bits from channel ------------------------------------*/
+
+	model[0].voiced = qt.unpack(bits, &nbit, 1);
+
+	model[1].voiced = qt.unpack(bits, &nbit, 1);
+	Wo_index = qt.unpack(bits, &nbit, WO_BITS);
+	model[1].Wo = decode_Wo_fixed(Wo_index);
+	model[1].L  = 0x80000000u / model[1].Wo;
+
+	e_index = qt.unpack(bits, &nbit, E_BITS);
+	e[1] = decode_energy_fixed(e_index);
+
+	model[2].voiced = qt.unpack(bits, &nbit, 1);
+
+	model[3].voiced = qt.unpack(bits, &nbit, 1);
+	Wo_index = qt.unpack(bits, &nbit, WO_BITS);
+	model[3].Wo = decode_Wo_fixed(Wo_index);
+	model[3].L  = 0x80000000u / model[3].Wo;
+
+	e_index = qt.unpack(bits, &nbit, E_BITS);
+	e[3] = decode_energy_fixed(e_index);
+
+	for(i=0; i<LSP_SCALAR_INDEXES; i++)
+	{
+		lsp_indexes[i] = qt.unpack(bits, &nbit, qt.lsp_bits(i));
+	}
+	for(i=0; i<LPC_ORD; i++)
+		lsps[3][i] = c2.lsp_cb_fx[i][lsp_indexes[i]];
+
+	/* check_lsp_order() */
+
+	for(i=1; i<LPC_ORD; i++)
+		if (lsps[3][i] < lsps[3][i-1])
+		{
+			int32_t tmp = lsps[3][i-1];
+			lsps[3][i-1] = lsps[3][i] - LSP_SWAP_HZ_Q16;
+			lsps[3][i] = tmp + LSP_SWAP_HZ_Q16;
+			i = 1;
+		}
+
+	/* bw_expand_lsps(), 50 and 100 Hz */
+
+	for(i=1; i<4; i++)
+		if (lsps[3][i] - lsps[3][i-1] < (50 << 16))
+			lsps[3][i] = lsps[3][i-1] + (50 << 16);
+	for(i=4; i<LPC_ORD; i++)
+		if (lsps[3][i] - lsps[3][i-1] < (100 << 16))
+			lsps[3][i] = lsps[3][i-1] + (100 << 16);
+
+	/* interpolate ------------------------------------------------*/
+
+	interp_Wo_fixed(&model[0], &c2.prev_model_dec_fx, &model[1]);
+	e[0] = (c2.prev_e_dec_fx + e[1]) / 2;
+	interp_Wo_fixed(&model[2], &model[1], &model[3]);
+	e[2] = (e[1] + e[3]) / 2;
+
+	for(i=0; i<3; i++)
+		for(int j=0; j<LPC_ORD; j++)
+			lsps[i][j] = (int32_t)(((int64_t)c2.prev_lsps_dec_fx[j]*(3-i) + (int64_t)lsps[3][j]*(i+1)) / 4);
+
+	for(i=0; i<4; i++)
+	{
+		lsp_to_lpc_fixed(&lsps[i][0], ak, LPC_ORD);
+		CODEC2_STAGE(C2_STAGE_AKS_TO_M2, aks_to_M2_fixed(ak, LPC_ORD, &model[i], e[i], Aw));
+		CODEC2_STAGE(C2_STAGE_SYNTHESISE, synthesise_one_frame_fixed(&model[i], Aw));
+		speech_out_fixed(&speech[c2.n_samp*i]);
+	}
+
+	/* update memories for next frame ----------------------------*/
+
+	c2.prev_model_dec_fx = model[3];
+	c2.prev_e_dec_fx = e[3];
+	for(i=0; i<LPC_ORD; i++)
+		c2.prev_lsps_dec_fx[i] = lsps[3][i];
+}
+
+/* the constructor in codec2.cpp takes the address of these */
+
+template void CCodec2::codec2_decode_3200_fixed<short>(short speech[], const unsigned char * bits);
+template void CCodec2::codec2_decode_3200_fixed<float>(float speech[], const unsigned char * bits);
+template void CCodec2::codec2_decode_1600_fixed<short>(short speech[], const unsigned char * bits);
+template void CCodec2::codec2_decode_1600_fixed<float>(float speech[], const unsigned char * bits);
+
+#endif
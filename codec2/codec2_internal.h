@@ -30,6 +30,9 @@
 #define __CODEC2_INTERNAL__
 
 #include "kiss_fft.h"
+#ifdef CODEC2_FIXED
+#include "fixed.h"
+#endif
 
 using CODEC2 = struct codec2_tag {
 	int                mode;
@@ -40,10 +43,12 @@ using CODEC2 = struct codec2_tag {
 	int                lpc_pf;                   /* LPC post filter on                        */
 	int                bass_boost;               /* LPC post filter bass boost                */
 	int                smoothing;                /* enable smoothing for channels with errors */
+	int                effort;                   /* encoder effort level, CODEC2_EFFORT_xxx   */
 	float              ex_phase;                 /* excitation model phase track              */
 	float              bg_est;                   /* background noise estimate for post filter */
 	float              prev_f0_enc;              /* previous frame's f0    estimate           */
 	float              prev_e_dec;               /* previous frame's LPC energy               */
+	unsigned long      rand_next;                /* codec2_rand() state                       */
 	float              beta;                     /* LPC post filter parameters                */
 	float              gamma;
 	float              xq_enc[2];                /* joint pitch and energy VQ states          */
@@ -62,6 +67,18 @@ using CODEC2 = struct codec2_tag {
 	std::vector<float> Sn;                       /* [m_pitch] input speech                    */
 	std::vector<float> Sn_;	                     /* [2*n_samp] synthesised output speech      */
 	std::vector<float> bpf_buf;                  /* buffer for band pass filter               */
+#ifdef CODEC2_FIXED
+	/* fixed point decoder states, see codec2_fixed.cpp */
+	uint32_t           ex_phase_fx;              /* excitation phase track, turns Q32         */
+	int32_t            bg_est_fx;                /* background noise estimate, log2 Q16       */
+	int32_t            prev_e_dec_fx;            /* previous frame's LPC energy, log2 Q16     */
+	int32_t            prev_lsps_dec_fx[LPC_ORD];/* previous frame's LSPs, Hz Q16             */
+	MODEL_FX           prev_model_dec_fx;        /* previous frame's model parameters         */
+	std::vector<int32_t> Pn_fx;                  /* [2*n_samp] synthesis window Q15           */
+	std::vector<int32_t> Sn_fx;                  /* [2*n_samp] synthesised output speech Q4   */
+	std::vector<int32_t> lsp_cb_fx[LPC_ORD];     /* lsp_cb[] in Hz Q16                        */
+	std::vector<int32_t> lspd_cb_fx[LPC_ORD];    /* lsp_cbd[] in Hz Q16                       */
+#endif
 };
 
 #endif
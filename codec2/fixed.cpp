@@ -0,0 +1,319 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: fixed.cpp
+
+  Integer maths for the fixed point Codec2 decoder, see fixed.h.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  Copyright (C) 2026 by agent
+
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef CODEC2_FIXED
+
+#include <math.h>
+
+#include "fixed.h"
+
+#define TABLE_SIZE (1<<FIXED_TABLE_BITS)
+
+CFixed::CFixed()
+{
+	int i;
+
+	for(i=0; i<=TABLE_SIZE; i++)
+	{
+		log_tab[i] = lround(log2(1.0 + (double)i/TABLE_SIZE) * 65536.0);
+		exp_tab[i] = lround(exp2((double)i/TABLE_SIZE) * 1073741824.0);
+		sin_tab[i] = lround(sin(2.0*M_PI*i/TABLE_SIZE) * 1073741824.0);
+	}
+	for(i=0; i<31; i++)
+		atan_tab[i] = llround(atan(ldexp(1.0, -i)) / (2.0*M_PI) * 4294967296.0);
+
+	for(i=0; i<FIXED_FFT_SIZE/2; i++)
+	{
+		uint32_t turn = (uint32_t)(((uint64_t)i << 32) / FIXED_FFT_SIZE);
+		tw[i].re = cos_q30(turn);
+		tw[i].im = -sin_q30(turn);
+	}
+
+	int bits = 0;
+	while ((1 << bits) < FIXED_FFT_SIZE/2)
+		bits++;
+	for(i=0; i<FIXED_FFT_SIZE/2; i++)
+	{
+		int r = 0;
+		for(int b=0; b<bits; b++)
+			if (i & (1 << b))
+				r |= 1 << (bits - 1 - b);
+		bitrev[i] = r;
+	}
+}
+
+int32_t CFixed::log2_q16(uint64_t x)
+{
+	if (0 == x)
+		return FIXED_LOG_ZERO;
+
+	int n = 63 - __builtin_clzll(x);
+	uint64_t m = x << (63 - n);		/* leading one now at bit 63 */
+	uint32_t idx  = (m >> (63 - FIXED_TABLE_BITS)) & (TABLE_SIZE - 1);
+	uint32_t frac = (m >> (63 - FIXED_TABLE_BITS - 16)) & 0xffff;
+
+	int32_t l = log_tab[idx] + (int32_t)(((int64_t)(log_tab[idx+1] - log_tab[idx]) * frac) >> 16);
+	return (n << 16) + l;
+}
+
+uint64_t CFixed::exp2_q16(int32_t y)
+{
+	int32_t  ip = y >> 16;		/* floor */
+	uint32_t f  = y & 0xffff;
+	uint32_t idx = f >> (16 - FIXED_TABLE_BITS);
+	uint32_t fr  = f & ((1 << (16 - FIXED_TABLE_BITS)) - 1);
+
+	uint64_t m = exp_tab[idx] + (((uint64_t)(exp_tab[idx+1] - exp_tab[idx]) * fr) >> (16 - FIXED_TABLE_BITS));
+
+	/* m is 2^frac in Q30 */
+
+	if (ip > 62)
+		ip = 62;
+	if (ip >= 30)
+		return m << (ip - 30);
+	if (30 - ip >= 64)
+		return 0;
+	return m >> (30 - ip);
+}
+
+/* Block floating point sum, the largest term sets the exponent */
+
+int32_t CFixed::log2_sum(const int32_t l[], int n)
+{
+	int32_t  max = FIXED_LOG_ZERO;
+	uint64_t sum = 0;
+	int      i;
+
+	for(i=0; i<n; i++)
+		if (l[i] > max)
+			max = l[i];
+	if (FIXED_LOG_ZERO == max)
+		return FIXED_LOG_ZERO;
+
+	for(i=0; i<n; i++)
+		sum += exp2_q16(l[i] - max + (30 << 16));
+
+	return log2_q16(sum) - (30 << 16) + max;
+}
+
+int32_t CFixed::sin_q30(uint32_t turn)
+{
+	/* sin(a + d) from the table entry at a and a Taylor series in d,
+	   linear interpolation alone is too coarse for LSPs close to 0 Hz */
+
+	uint32_t idx = turn >> (32 - FIXED_TABLE_BITS);
+	int64_t  s   = sin_tab[idx];
+	int64_t  c   = sin_tab[(idx + TABLE_SIZE/4) & (TABLE_SIZE - 1)];
+	int64_t  d   = ((int64_t)(turn & ((1u << (32 - FIXED_TABLE_BITS)) - 1)) * 1686629713) >> 30;	/* radians Q30 */
+	int64_t  d2  = (d * d) >> 31;			/* d^2/2 */
+	int64_t  d3  = ((d2 * d) >> 30) / 3;	/* d^3/6 */
+
+	return (int32_t)(s - ((s * d2) >> 30) + ((c * (d - d3)) >> 30));
+}
+
+int32_t CFixed::cos_q30(uint32_t turn)
+{
+	return sin_q30(turn + 0x40000000u);
+}
+
+/* CORDIC in vectoring mode, result is the angle of x + jy */
+
+uint32_t CFixed::atan2_turn(int32_t y, int32_t x)
+{
+	int64_t  xx = x, yy = y;
+	uint32_t angle = 0;
+
+	if (0 == x && 0 == y)
+		return 0;
+
+	/* bring into the right half plane */
+
+	if (xx < 0)
+	{
+		xx = -xx;
+		yy = -yy;
+		angle = 0x80000000u;
+	}
+
+	/* scale small vectors up for full precision */
+
+	while ((xx < (1 << 28)) && (yy < (1 << 28)) && (yy > -(1 << 28)))
+	{
+		xx <<= 1;
+		yy <<= 1;
+	}
+
+	for(int i=0; i<31; i++)
+	{
+		int64_t nx;
+		if (yy > 0)
+		{
+			nx = xx + (yy >> i);
+			yy = yy - (xx >> i);
+			angle += atan_tab[i];
+		}
+		else
+		{
+			nx = xx - (yy >> i);
+			yy = yy + (xx >> i);
+			angle -= atan_tab[i];
+		}
+		xx = nx;
+	}
+
+	return angle;
+}
+
+/* In place radix 2 complex FFT of FIXED_FFT_SIZE/2 points, not scaled */
+
+void CFixed::fft(FX_COMPLEX buf[], bool inverse)
+{
+	const int n = FIXED_FFT_SIZE/2;
+	int i, j, len;
+
+	for(i=0; i<n; i++)
+	{
+		if (i < bitrev[i])
+		{
+			FX_COMPLEX t = buf[i];
+			buf[i] = buf[bitrev[i]];
+			buf[bitrev[i]] = t;
+		}
+	}
+
+	for(len=2; len<=n; len<<=1)
+	{
+		int half = len/2;
+		int step = FIXED_FFT_SIZE/len;
+		for(i=0; i<n; i+=len)
+		{
+			for(j=0; j<half; j++)
+			{
+				int32_t wr = tw[j*step].re;
+				int32_t wi = inverse ? -tw[j*step].im : tw[j*step].im;
+				FX_COMPLEX a = buf[i+j];
+				FX_COMPLEX b = buf[i+j+half];
+				int32_t tr = (int32_t)(((int64_t)b.re*wr - (int64_t)b.im*wi + (1 << 29)) >> 30);
+				int32_t ti = (int32_t)(((int64_t)b.re*wi + (int64_t)b.im*wr + (1 << 29)) >> 30);
+				buf[i+j].re = a.re + tr;
+				buf[i+j].im = a.im + ti;
+				buf[i+j+half].re = a.re - tr;
+				buf[i+j+half].im = a.im - ti;
+			}
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*\
+
+  fftr()
+
+  Real FFT of FIXED_FFT_SIZE samples using a complex FFT of half the
+  size, same scaling and output layout as kiss_fftr().  The caller must
+  leave enough headroom for the sum of the input magnitudes.
+
+\*---------------------------------------------------------------------------*/
+
+void CFixed::fftr(const int32_t in[], FX_COMPLEX out[])
+{
+	const int n = FIXED_FFT_SIZE/2;
+	FX_COMPLEX z[FIXED_FFT_SIZE/2];
+	int k;
+
+	for(k=0; k<n; k++)
+	{
+		z[k].re = in[2*k];
+		z[k].im = in[2*k+1];
+	}
+	fft(z, false);
+
+	out[0].re = z[0].re + z[0].im;
+	out[0].im = 0;
+	out[n].re = z[0].re - z[0].im;
+	out[n].im = 0;
+
+	for(k=1; k<n; k++)
+	{
+		FX_COMPLEX zk = z[k], zn = z[n-k];
+
+		/* even part, twice its value */
+		int64_t er = (int64_t)zk.re + zn.re;
+		int64_t ei = (int64_t)zk.im - zn.im;
+		/* odd part, twice its value */
+		int64_t or_ = (int64_t)zk.im + zn.im;
+		int64_t oi  = (int64_t)zn.re - zk.re;
+
+		int64_t wr = tw[k].re, wi = tw[k].im;
+		int64_t tr = (or_*wr - oi*wi + (1 << 29)) >> 30;
+		int64_t ti = (or_*wi + oi*wr + (1 << 29)) >> 30;
+
+		out[k].re = (int32_t)((er + tr + 1) >> 1);
+		out[k].im = (int32_t)((ei + ti + 1) >> 1);
+	}
+}
+
+/*---------------------------------------------------------------------------*\
+
+  fftri()
+
+  Inverse of fftr(), not normalised, so the output is FIXED_FFT_SIZE
+  times the true inverse just like kiss_fftri().
+
+\*---------------------------------------------------------------------------*/
+
+void CFixed::fftri(const FX_COMPLEX in[], int32_t out[])
+{
+	const int n = FIXED_FFT_SIZE/2;
+	FX_COMPLEX z[FIXED_FFT_SIZE/2];
+	int k;
+
+	for(k=0; k<n; k++)
+	{
+		FX_COMPLEX xk = in[k], xn = in[n-k];
+
+		/* Fe = X[k] + conj(X[n-k]) */
+		int64_t er = (int64_t)xk.re + xn.re;
+		int64_t ei = (int64_t)xk.im - xn.im;
+		/* Fo = (X[k] - conj(X[n-k])) e^(j 2 pi k/N) */
+		int64_t dr = (int64_t)xk.re - xn.re;
+		int64_t di = (int64_t)xk.im + xn.im;
+		int64_t wr = tw[k].re, wi = -tw[k].im;
+		int64_t or_ = (dr*wr - di*wi + (1 << 29)) >> 30;
+		int64_t oi  = (dr*wi + di*wr + (1 << 29)) >> 30;
+
+		/* Z = Fe + j Fo */
+		z[k].re = (int32_t)(er - oi);
+		z[k].im = (int32_t)(ei + or_);
+	}
+	fft(z, true);
+
+	for(k=0; k<n; k++)
+	{
+		out[2*k]   = z[k].re;
+		out[2*k+1] = z[k].im;
+	}
+}
+
+#endif
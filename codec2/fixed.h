@@ -0,0 +1,90 @@
+/*---------------------------------------------------------------------------*\
+
+  FILE........: fixed.h
+
+  Integer maths for the fixed point Codec2 decoder, built when
+  CODEC2_FIXED is defined.
+
+  Formats used throughout:
+
+    angles      uint32_t, fraction of a turn in Q32, so they wrap for free
+    log2 values int32_t Q16, FIXED_LOG_ZERO stands in for log2(0)
+    sin/cos     int32_t Q30
+    FFT data    int32_t, unscaled, the caller picks the Q format
+
+  The tables are built once in the constructor, every per frame call is
+  integer only.
+
+\*---------------------------------------------------------------------------*/
+
+/*
+  Copyright (C) 2026 by agent
+
+  All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License version 2.1, as
+  published by the Free Software Foundation.  This program is
+  distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+  License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program; if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __FIXED__
+#define __FIXED__
+
+#include <stdint.h>
+
+#include "defines.h"
+
+#define FIXED_FFT_SIZE   512		/* real FFT size, same as FFT_ENC and FFT_DEC */
+#define FIXED_TABLE_BITS 10			/* log2 entries in the interpolated tables    */
+#define FIXED_LOG_ZERO   (-0x40000000)	/* log2 of zero, far below any real value */
+
+using FX_COMPLEX = struct fx_complex_tag
+{
+	int32_t re, im;
+};
+
+/* fixed point version of MODEL, amplitudes are kept as log2 values */
+
+using MODEL_FX = struct model_fx_tag
+{
+	uint32_t Wo;			  /* fundamental frequency, turns per sample Q32 */
+	int      L;				  /* number of harmonics                         */
+	int32_t  lA[MAX_AMP+1];	  /* log2 amplitude of each harmonic Q16         */
+	uint32_t phi[MAX_AMP+1];  /* phase of each harmonic, turns Q32           */
+	int      voiced;		  /* non-zero if this frame is voiced            */
+};
+
+class CFixed
+{
+public:
+	CFixed();
+
+	int32_t  log2_q16(uint64_t x);				/* log2(x), x an integer                 */
+	uint64_t exp2_q16(int32_t y);				/* 2^y, y in Q16, rounded down to int    */
+	int32_t  log2_sum(const int32_t l[], int n);	/* log2 of the sum of 2^l[i]             */
+	int32_t  cos_q30(uint32_t turn);
+	int32_t  sin_q30(uint32_t turn);
+	uint32_t atan2_turn(int32_t y, int32_t x);
+
+	void fftr(const int32_t in[], FX_COMPLEX out[]);	/* FIXED_FFT_SIZE in, FIXED_FFT_SIZE/2+1 out */
+	void fftri(const FX_COMPLEX in[], int32_t out[]);	/* inverse of fftr(), times FIXED_FFT_SIZE   */
+
+private:
+	void fft(FX_COMPLEX buf[], bool inverse);
+
+	int32_t  log_tab[(1<<FIXED_TABLE_BITS)+1];	/* log2(1+i/1024) Q16           */
+	uint32_t exp_tab[(1<<FIXED_TABLE_BITS)+1];	/* 2^(i/1024) Q30               */
+	int32_t  sin_tab[(1<<FIXED_TABLE_BITS)+1];	/* sin(2 pi i/1024) Q30         */
+	uint32_t atan_tab[31];						/* atan(2^-i) in turns Q32      */
+	FX_COMPLEX tw[FIXED_FFT_SIZE/2];			/* e^-j2pi k/FIXED_FFT_SIZE Q30 */
+	int      bitrev[FIXED_FFT_SIZE/2];
+};
+
+#endif
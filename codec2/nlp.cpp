@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "defines.h"
 #include "nlp.h"
@@ -248,13 +249,25 @@ float Cnlp::nlp(
 //	float  W[],    /* Freq domain window                                 */
 	float *prev_f0 /* previous pitch f0 in Hz, memory for pitch tracking */
 )
+{
+	nlp_filter(Sn, n);
+	return nlp_search(pitch, prev_f0);
+}
+
+/*---------------------------------------------------------------------------*\
+
+  nlp_filter()
+
+  First half of nlp(), squares, notch and low pass filters the n new
+  samples of Sn[].  Must be followed by either nlp_search() or
+  nlp_skip(), which shift the filtered samples out of the buffer.
+
+\*---------------------------------------------------------------------------*/
+
+void Cnlp::nlp_filter(float Sn[], int n)
 {
 	float  notch;		    /* current notch filter output          */
-	std::complex<float>   Fw[PE_FFT_SIZE]; /* DFT of squared signal (input/output) */
-	float  gmax;
-	int    gmax_bin;
 	int    m, i, j;
-	float  best_f0;
 
 	m = snlp.m;
 
@@ -327,8 +340,30 @@ float Cnlp::nlp(
 			snlp.sq[i] += snlp.mem_fir[j]*nlp_fir[j];
 	}
 
-	/* Decimate and DFT */
+	snlp.n = n;
+}
 
+/*---------------------------------------------------------------------------*\
+
+  nlp_search()
+
+  Second half of nlp(), finds the pitch of the samples filtered by
+  nlp_filter().
+
+\*---------------------------------------------------------------------------*/
+
+float Cnlp::nlp_search(float *pitch, float *prev_f0)
+{
+	std::complex<float>   Fw[PE_FFT_SIZE]; /* DFT of squared signal (input/output) */
+	float  gmax;
+	int    gmax_bin;
+	int    m, n, i;
+	float  best_f0;
+
+	m = (snlp.Fs == 16000) ? snlp.m/2 : snlp.m;
+	n = snlp.n;
+
+	/* Decimate and DFT */
 	for(i=0; i<PE_FFT_SIZE; i++)
 	{
 		Fw[i].real(0);
@@ -380,6 +415,70 @@ float Cnlp::nlp(
 	return(best_f0);
 }
 
+/*---------------------------------------------------------------------------*\
+
+  nlp_skip()
+
+  Alternative to nlp_search() when the caller can make do with the
+  previous F0, only shifts the filtered samples so the NLP memories
+  stay in step with the input.
+
+\*---------------------------------------------------------------------------*/
+
+float Cnlp::nlp_skip(float *pitch, float *prev_f0)
+{
+	int m = (snlp.Fs == 16000) ? snlp.m/2 : snlp.m;
+	int n = snlp.n;
+
+	for(int i=0; i<m-n; i++)
+		snlp.sq[i] = snlp.sq[i+n];
+
+	*pitch = (float)snlp.Fs / *prev_f0;
+
+	return *prev_f0;
+}
+
+/*---------------------------------------------------------------------------*\
+
+  nlp_state_bytes(), nlp_save_state(), nlp_restore_state()
+
+  The filter memories carried from one nlp_filter() call to the next,
+  for CCodec2::codec2_save_state().  Only the 8 kHz memories are kept,
+  the 16 kHz decimator is not used by the modes in this tree.
+
+\*---------------------------------------------------------------------------*/
+
+int Cnlp::nlp_state_bytes()
+{
+	return snlp.m*sizeof(float) + 2*sizeof(float) + NLP_NTAP*sizeof(float);
+}
+
+void Cnlp::nlp_save_state(unsigned char *state)
+{
+	assert(snlp.Fs == 8000);
+
+	memcpy(state, snlp.sq, snlp.m*sizeof(float));
+	state += snlp.m*sizeof(float);
+	memcpy(state, &snlp.mem_x, sizeof(float));
+	state += sizeof(float);
+	memcpy(state, &snlp.mem_y, sizeof(float));
+	state += sizeof(float);
+	memcpy(state, snlp.mem_fir, NLP_NTAP*sizeof(float));
+}
+
+void Cnlp::nlp_restore_state(const unsigned char *state)
+{
+	assert(snlp.Fs == 8000);
+
+	memcpy(snlp.sq, state, snlp.m*sizeof(float));
+	state += snlp.m*sizeof(float);
+	memcpy(&snlp.mem_x, state, sizeof(float));
+	state += sizeof(float);
+	memcpy(&snlp.mem_y, state, sizeof(float));
+	state += sizeof(float);
+	memcpy(snlp.mem_fir, state, NLP_NTAP*sizeof(float));
+}
+
 /*---------------------------------------------------------------------------*\
 
   post_process_sub_multiples()
@@ -61,6 +61,7 @@ using NLP = struct nlp_tag
 {
 	int           Fs;                /* sample rate in Hz            */
 	int           m;
+	int           n;                 /* new samples from last nlp_filter() */
 	float         w[PMAX_M/DEC];     /* DFT window                   */
 	float         sq[PMAX_M];	     /* squared speech samples       */
 	float         mem_x,mem_y;       /* memory for notch filter      */
@@ -75,6 +76,12 @@ public:
 	void nlp_create(C2CONST *c2const);
 	void nlp_destroy();
 	float nlp(float Sn[], int n, float *pitch_samples, float *prev_f0);
+	void  nlp_filter(float Sn[], int n);
+	float nlp_search(float *pitch_samples, float *prev_f0);
+	float nlp_skip(float *pitch_samples, float *prev_f0);
+	int   nlp_state_bytes();
+	void  nlp_save_state(unsigned char *state);
+	void  nlp_restore_state(const unsigned char *state);
 	void codec2_fft_inplace(FFT_STATE &cfg, std::complex<float> *inout);
 
 private:
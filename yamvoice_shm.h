@@ -0,0 +1,297 @@
+/*
+ *   Copyright (c) 2026 by agent
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+// yamvoice shared memory audio port, for C and C++ programs on Linux
+// and OpenBSD.  Header only, link with -lrt on glibc before 2.34, and
+// with -std=c99 or c11 define _GNU_SOURCE before any #include.
+//
+// With AudioIn or AudioOut set to shm:<name>, yamvoice exchanges audio
+// with a local program through the POSIX shared memory /yamvoice-<name>,
+// without a sound card, kernel round trip or resampling.  It holds two
+// rings of 8000Hz mono 16 bit samples: YV_SHM_IN is what yamvoice
+// transmits, like a microphone, YV_SHM_OUT is what it receives, like a
+// speaker.  Each ring has one writer and one reader, a side that has to
+// wait sleeps on a futex on the ring position it waits for.  Either side
+// may create the memory.
+//
+//	yv_shm *shm = yv_shm_attach("sdr");
+//	yv_shm_write(shm, mic, 160, 100);		// yamvoice transmits this
+//	n = yv_shm_read(shm, speaker, 160, 0);		// what yamvoice received
+//	yv_shm_detach(shm);
+//
+// yv_ring_peek()/yv_ring_consume() and yv_ring_reserve()/yv_ring_commit()
+// read and write in place, without a copy.
+
+#ifndef YAMVOICE_SHM_H
+#define YAMVOICE_SHM_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#elif defined(__OpenBSD__)
+#include <sys/futex.h>
+#else
+#error "yamvoice_shm.h needs futex(2), Linux or OpenBSD"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define YV_SHM_MAGIC   0x31564d59u	// "YMV1"
+#define YV_SHM_VERSION 1u
+#define YV_SHM_RATE    8000u
+#define YV_SHM_SAMPLES 8192u	// per ring, a power of two, about one second
+#define YV_SHM_IN      0	// to yamvoice, for transmit
+#define YV_SHM_OUT     1	// from yamvoice, what it receives
+
+#define YV_ALIGNED __attribute__((aligned(64)))	// the writer's and reader's words on their own cache lines
+
+// Positions count samples since the memory was made and wrap at 2^32,
+// head - tail is what the ring holds.
+typedef struct yv_ring
+{
+	uint32_t head YV_ALIGNED;	// the writer's
+	uint32_t head_waiters;	// readers asleep on head
+	uint32_t overruns;	// writes that found too little room, some samples were lost
+	uint32_t tail YV_ALIGNED;	// the reader's
+	uint32_t tail_waiters;	// writers asleep on tail
+	uint32_t underruns;	// reads that found too few samples
+	int16_t data[YV_SHM_SAMPLES] YV_ALIGNED;
+} yv_ring;
+
+typedef struct yv_shm
+{
+	uint32_t magic, version, rate, samples;
+	uint32_t state;	// 0 new, 1 being set up, 2 ready
+	yv_ring ring[2] YV_ALIGNED;
+} yv_shm;
+
+static inline void yv_futex_wait(uint32_t *addr, uint32_t val, int timeout_ms)
+{
+	struct timespec ts, *pts = NULL;
+	if (timeout_ms >= 0) {
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+		pts = &ts;
+	}
+#if defined(__linux__)
+	syscall(SYS_futex, addr, FUTEX_WAIT, val, pts, NULL, 0);
+#else
+	futex(addr, FUTEX_WAIT, val, pts, NULL);
+#endif
+}
+
+static inline void yv_futex_wake(uint32_t *addr)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+	futex(addr, FUTEX_WAKE, 1, NULL, NULL);
+#endif
+}
+
+static inline long long yv_now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000L;
+}
+
+static inline unsigned int yv_ring_readable(yv_ring *r)
+{
+	return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+static inline unsigned int yv_ring_writable(yv_ring *r)
+{
+	return YV_SHM_SAMPLES - yv_ring_readable(r);
+}
+
+// Sleeps until the ring holds at least count samples (for_data) or has
+// room for count, for up to timeout_ms, -1 is forever.  Returns 1 when
+// they are there.
+static inline int yv_ring_wait(yv_ring *r, unsigned int count, int for_data, int timeout_ms)
+{
+	uint32_t *pos = for_data ? &r->head : &r->tail;
+	uint32_t *waiters = for_data ? &r->head_waiters : &r->tail_waiters;
+	const long long deadline = yv_now_ms() + timeout_ms;
+	for ( ; ; ) {
+		uint32_t seen = __atomic_load_n(pos, __ATOMIC_SEQ_CST);
+		if ((for_data ? yv_ring_readable(r) : yv_ring_writable(r)) >= count)
+			return 1;
+		int left = -1;
+		if (timeout_ms >= 0 && (left = (int)(deadline - yv_now_ms())) <= 0)
+			return 0;
+		__atomic_add_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+		// the other side moves pos before it looks for waiters
+		if (__atomic_load_n(pos, __ATOMIC_SEQ_CST) == seen)
+			yv_futex_wait(pos, seen, left);
+		__atomic_sub_fetch(waiters, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+// the samples that can be read in place, *p points at the first
+static inline unsigned int yv_ring_peek(yv_ring *r, const int16_t **p)
+{
+	const uint32_t at = r->tail & (YV_SHM_SAMPLES - 1);
+	const unsigned int n = yv_ring_readable(r);
+	*p = r->data + at;
+	return (n < YV_SHM_SAMPLES - at) ? n : YV_SHM_SAMPLES - at;
+}
+
+static inline void yv_ring_consume(yv_ring *r, unsigned int count)
+{
+	__atomic_store_n(&r->tail, r->tail + count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->tail_waiters, __ATOMIC_SEQ_CST))
+		yv_futex_wake(&r->tail);
+}
+
+// the samples that can be written in place, *p points at the first
+static inline unsigned int yv_ring_reserve(yv_ring *r, int16_t **p)
+{
+	const uint32_t at = r->head & (YV_SHM_SAMPLES - 1);
+	const unsigned int n = yv_ring_writable(r);
+	*p = r->data + at;
+	return (n < YV_SHM_SAMPLES - at) ? n : YV_SHM_SAMPLES - at;
+}
+
+static inline void yv_ring_commit(yv_ring *r, unsigned int count)
+{
+	__atomic_store_n(&r->head, r->head + count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->head_waiters, __ATOMIC_SEQ_CST))
+		yv_futex_wake(&r->head);
+}
+
+// Copies up to count samples out, waiting up to timeout_ms for all of
+// them.  A short read is an underrun.  Returns the samples read.
+static inline unsigned int yv_ring_read(yv_ring *r, int16_t *out, unsigned int count, int timeout_ms)
+{
+	unsigned int done = 0;
+	yv_ring_wait(r, count, 1, timeout_ms);
+	while (done < count) {
+		const int16_t *p;
+		unsigned int n = yv_ring_peek(r, &p);
+		if (0 == n)
+			break;
+		if (n > count - done)
+			n = count - done;
+		memcpy(out + done, p, n * sizeof(int16_t));
+		yv_ring_consume(r, n);
+		done += n;
+	}
+	if (done < count)
+		__atomic_add_fetch(&r->underruns, 1, __ATOMIC_RELAXED);
+	return done;
+}
+
+// Copies up to count samples in, waiting up to timeout_ms for room for
+// all of them.  What does not fit is lost, an overrun.  Returns the
+// samples written.
+static inline unsigned int yv_ring_write(yv_ring *r, const int16_t *in, unsigned int count, int timeout_ms)
+{
+	unsigned int done = 0;
+	yv_ring_wait(r, count, 0, timeout_ms);
+	while (done < count) {
+		int16_t *p;
+		unsigned int n = yv_ring_reserve(r, &p);
+		if (0 == n)
+			break;
+		if (n > count - done)
+			n = count - done;
+		memcpy(p, in + done, n * sizeof(int16_t));
+		yv_ring_commit(r, n);
+		done += n;
+	}
+	if (done < count)
+		__atomic_add_fetch(&r->overruns, 1, __ATOMIC_RELAXED);
+	return done;
+}
+
+// Maps /yamvoice-<name>, making it if it is not there.  NULL on error,
+// with errno set.
+static inline yv_shm *yv_shm_attach(const char *name)
+{
+	char path[256];
+	struct stat st;
+	yv_shm *shm;
+	uint32_t expect = 0;
+	int fd, i;
+
+	snprintf(path, sizeof(path), "/yamvoice-%s", name);
+	fd = shm_open(path, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || (st.st_size < (off_t)sizeof(yv_shm) && ftruncate(fd, sizeof(yv_shm)) < 0)) {
+		close(fd);
+		return NULL;
+	}
+	shm = (yv_shm *)mmap(NULL, sizeof(yv_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (MAP_FAILED == shm)
+		return NULL;
+	if (__atomic_compare_exchange_n(&shm->state, &expect, 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		shm->magic = YV_SHM_MAGIC;
+		shm->version = YV_SHM_VERSION;
+		shm->rate = YV_SHM_RATE;
+		shm->samples = YV_SHM_SAMPLES;
+		__atomic_store_n(&shm->state, 2, __ATOMIC_RELEASE);
+	}
+	for (i = 0; i < 1000 && 2 != __atomic_load_n(&shm->state, __ATOMIC_ACQUIRE); i++) {
+		const struct timespec ms = { 0, 1000000L };
+		nanosleep(&ms, NULL);	// the other side is setting it up
+	}
+	if (2 != __atomic_load_n(&shm->state, __ATOMIC_ACQUIRE) || YV_SHM_MAGIC != shm->magic || YV_SHM_VERSION != shm->version
+	    || YV_SHM_RATE != shm->rate || YV_SHM_SAMPLES != shm->samples) {
+		munmap(shm, sizeof(yv_shm));
+		errno = EPROTO;
+		return NULL;
+	}
+	return shm;
+}
+
+static inline void yv_shm_detach(yv_shm *shm)
+{
+	munmap(shm, sizeof(yv_shm));
+}
+
+// for the program on the other side of yamvoice
+static inline unsigned int yv_shm_write(yv_shm *shm, const int16_t *in, unsigned int count, int timeout_ms)
+{
+	return yv_ring_write(&shm->ring[YV_SHM_IN], in, count, timeout_ms);
+}
+
+static inline unsigned int yv_shm_read(yv_shm *shm, int16_t *out, unsigned int count, int timeout_ms)
+{
+	return yv_ring_read(&shm->ring[YV_SHM_OUT], out, count, timeout_ms);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif